@@ -0,0 +1,225 @@
+#include <iostream>
+#include <cstring>
+
+#include <SDL.h>
+
+#include "audio.h"
+#include "util.h"
+
+Sound::Sound() {
+	this->samples = nullptr;
+	this->length = 0;
+}
+
+Sound::~Sound() {
+	delete[] this->samples;
+}
+
+Mixer::Mixer(int frequency, int bufferSamples) {
+	// SDL wants a power of two
+	int roundedSamples = MIXER_MIN_BUFFER_SAMPLES;
+	while (roundedSamples < bufferSamples && roundedSamples < MIXER_MAX_BUFFER_SAMPLES) {
+		roundedSamples *= 2;
+	}
+	bufferSamples = roundedSamples;
+	for (int i = 0; i < MIXER_MAX_VOICES; ++i) {
+		this->voices[i].sound = nullptr;
+		this->voices[i].position = 0;
+	}
+
+	SDL_AudioSpec wanted;
+	SDL_memset(&wanted, 0, sizeof(wanted));
+	wanted.freq = frequency;
+	wanted.format = AUDIO_S16SYS;
+	wanted.channels = 1;
+	wanted.samples = static_cast<Uint16>(bufferSamples);
+	wanted.callback = &Mixer::audioCallback;
+	wanted.userdata = this;
+
+	// no allowed changes: SDL converts behind the scenes if the hardware wants something else, so the
+	// cache and the mixer only ever have to deal with mono S16 at our frequency
+	this->device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &this->spec, 0);
+	if (this->device == 0) {
+		// not fatal: better to play silently than not at all
+		std::cerr << "SDL Error: SDL_OpenAudioDevice: " << SDL_GetError() << " - sound disabled" << std::endl;
+		this->spec = wanted;
+	} else {
+		std::cout << "Audio: " << SDL_GetCurrentAudioDriver() << " driver, " << this->spec.freq << "Hz, "
+			<< this->spec.samples << " sample buffer" << std::endl;
+	}
+	this->samplesPerTick = static_cast<int>(this->spec.freq * PHYSICS_TIMESTEP);
+
+	// tones roughly match the original arcade machine
+	loadSound(SoundId::PaddleHit, "paddle.wav", 459, 96);
+	loadSound(SoundId::WallBounce, "wall.wav", 226, 16);
+	loadSound(SoundId::Score, "score.wav", 490, 257);
+
+	if (this->device != 0) {
+		SDL_PauseAudioDevice(this->device, 0);
+	}
+}
+
+Mixer::~Mixer() {
+	if (this->device != 0) {
+		SDL_CloseAudioDevice(this->device);
+	}
+}
+
+void Mixer::loadSound(SoundId id, const char *file, int toneFrequency, int durationMs) {
+	Sound &sound = this->sounds[static_cast<int>(id)];
+
+	SDL_AudioSpec wavSpec;
+	Uint8 *wavBuffer;
+	Uint32 wavLength;
+	if (SDL_LoadWAV(file, &wavSpec, &wavBuffer, &wavLength) == nullptr) {
+		synthesizeTone(sound, toneFrequency, durationMs);
+		return;
+	}
+
+	SDL_AudioCVT cvt;
+	if (SDL_BuildAudioCVT(&cvt, wavSpec.format, wavSpec.channels, wavSpec.freq,
+			AUDIO_S16SYS, 1, this->spec.freq) < 0) {
+		std::cerr << "SDL Error: SDL_BuildAudioCVT: " << SDL_GetError() << " - using a tone for " << file << std::endl;
+		SDL_FreeWAV(wavBuffer);
+		synthesizeTone(sound, toneFrequency, durationMs);
+		return;
+	}
+	cvt.len = static_cast<int>(wavLength);
+	cvt.buf = new Uint8[cvt.len * cvt.len_mult];
+	std::memcpy(cvt.buf, wavBuffer, wavLength);
+	SDL_FreeWAV(wavBuffer);
+	if (SDL_ConvertAudio(&cvt) != 0) {
+		logSDLError("SDL_ConvertAudio");
+	}
+
+	sound.length = cvt.len_cvt / static_cast<int>(sizeof(Sint16));
+	sound.samples = new Sint16[sound.length];
+	std::memcpy(sound.samples, cvt.buf, sound.length * sizeof(Sint16));
+	delete[] cvt.buf;
+}
+
+void Mixer::synthesizeTone(Sound &sound, int toneFrequency, int durationMs) {
+	const Sint16 amplitude = 6000;
+	const int fadeLength = this->spec.freq / 200; // 5ms fade out to avoid a click at the end
+	const int halfPeriod = this->spec.freq / (toneFrequency * 2);
+
+	sound.length = this->spec.freq * durationMs / 1000;
+	sound.samples = new Sint16[sound.length];
+	for (int i = 0; i < sound.length; ++i) {
+		Sint32 sample = (i / halfPeriod) % 2 == 0 ? amplitude : -amplitude;
+		const int remaining = sound.length - i;
+		if (remaining < fadeLength) {
+			sample = sample * remaining / fadeLength;
+		}
+		sound.samples[i] = static_cast<Sint16>(sample);
+	}
+}
+
+void Mixer::onWorldEvent(WorldEvent event, Uint32 tick) {
+	switch (event) {
+	case WorldEvent::PaddleHit:
+		play(SoundId::PaddleHit, tick);
+		break;
+	case WorldEvent::WallBounce:
+		play(SoundId::WallBounce, tick);
+		break;
+	case WorldEvent::Score:
+		play(SoundId::Score, tick);
+		break;
+	}
+}
+
+void Mixer::setPaused(bool paused) {
+	if (this->device != 0) {
+		SDL_PauseAudioDevice(this->device, paused ? 1 : 0);
+	}
+}
+
+void Mixer::play(SoundId sound, Uint32 tick) {
+	SoundEvent event = { sound, tick };
+	if (!this->queue.push(event)) {
+		std::cerr << "Sound queue full; dropping sound" << std::endl;
+	}
+}
+
+void SDLCALL Mixer::audioCallback(void *userdata, Uint8 *stream, int len) {
+	Mixer *mixer = static_cast<Mixer *>(userdata);
+	Sint16 *out = reinterpret_cast<Sint16 *>(stream);
+	int frames = len / static_cast<int>(sizeof(Sint16));
+	while (frames > 0) {
+		const int chunk = frames < MIXER_MAX_BUFFER_SAMPLES ? frames : MIXER_MAX_BUFFER_SAMPLES;
+		mixer->mix(out, chunk);
+		out += chunk;
+		frames -= chunk;
+	}
+}
+
+void Mixer::mix(Sint16 *out, int frames) {
+	// start newly requested sounds. The game simulates in bursts (several ticks per rendered frame), so
+	// offset each sound by how many ticks after the first one in this batch it happened; that keeps
+	// their spacing the same as in the simulation, at the cost of at most one buffer of extra latency.
+	SoundEvent event;
+	bool haveFirstTick = false;
+	Uint32 firstTick = 0;
+	while (this->queue.pop(event)) {
+		if (!haveFirstTick) {
+			firstTick = event.tick;
+			haveFirstTick = true;
+		}
+		int delay = static_cast<int>(event.tick - firstTick) * this->samplesPerTick;
+		if (delay > frames - 1) {
+			delay = frames - 1;
+		}
+
+		// use a free voice, or steal whichever has been playing longest
+		Voice *voice = &this->voices[0];
+		for (int i = 0; i < MIXER_MAX_VOICES; ++i) {
+			if (this->voices[i].sound == nullptr) {
+				voice = &this->voices[i];
+				break;
+			}
+			if (this->voices[i].position > voice->position) {
+				voice = &this->voices[i];
+			}
+		}
+		voice->sound = &this->sounds[static_cast<int>(event.sound)];
+		voice->position = -delay;
+	}
+
+	std::memset(this->mixBuffer, 0, frames * sizeof(Sint32));
+	for (int i = 0; i < MIXER_MAX_VOICES; ++i) {
+		Voice &voice = this->voices[i];
+		if (voice.sound == nullptr) {
+			continue;
+		}
+		int outIndex = 0;
+		if (voice.position < 0) {
+			outIndex = -voice.position;
+			voice.position = 0;
+			if (outIndex >= frames) { // can't happen given the clamping above, but be safe
+				voice.position = -(outIndex - frames);
+				continue;
+			}
+		}
+		const int available = voice.sound->length - voice.position;
+		const int count = available < frames - outIndex ? available : frames - outIndex;
+		const Sint16 *samples = voice.sound->samples + voice.position;
+		for (int j = 0; j < count; ++j) {
+			this->mixBuffer[outIndex + j] += samples[j];
+		}
+		voice.position += count;
+		if (voice.position >= voice.sound->length) {
+			voice.sound = nullptr;
+		}
+	}
+
+	for (int i = 0; i < frames; ++i) {
+		Sint32 sample = this->mixBuffer[i];
+		if (sample > 32767) {
+			sample = 32767;
+		} else if (sample < -32768) {
+			sample = -32768;
+		}
+		out[i] = static_cast<Sint16>(sample);
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <SDL.h>
+
+#include "util.h"
+#include "world.h"
+#include "spsc_queue.h"
+
+#define MIXER_MAX_VOICES 16
+#define MIXER_QUEUE_SIZE 64
+#define MIXER_MIN_BUFFER_SAMPLES 16
+#define MIXER_MAX_BUFFER_SAMPLES 8192 // also the most the callback mixes at a time
+
+enum class SoundId {
+	PaddleHit,
+	WallBounce,
+	Score,
+	Count
+};
+
+/* A sound effect, already decoded/converted into the output device's format (mono, signed 16 bit) */
+class Sound {
+public:
+	Sint16 *samples;
+	int length;
+
+	Sound();
+	~Sound();
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(Sound);
+};
+
+/* Sound playback request passed from the game thread to the audio callback */
+struct SoundEvent {
+	SoundId sound;
+	Uint32 tick;
+};
+
+/**
+* Software mixer which runs inside the SDL audio callback.
+*
+* All sounds are decoded into a cache when the mixer is created; after that the game thread only ever
+* pushes SoundEvents onto a lock-free queue (via onWorldEvent) and the callback only ever mixes from the
+* cache into a fixed set of voices, so neither side allocates or takes a lock.
+*
+* Use SDL_AUDIODRIVER=disk (or dummy) to run without a real sound card, e.g. on CI.
+*/
+class Mixer : public WorldListener {
+public:
+	/**
+	* @param frequency the output sample rate, e.g. 44100
+	* @param bufferSamples size of the device buffer in sample frames; smaller is lower latency but
+	* more likely to underrun. Rounded up to a power of two, between MIXER_MIN_BUFFER_SAMPLES and
+	* MIXER_MAX_BUFFER_SAMPLES.
+	*/
+	Mixer(int frequency, int bufferSamples);
+	~Mixer();
+
+	virtual void onWorldEvent(WorldEvent event, Uint32 tick) override;
+
+	void play(SoundId sound, Uint32 tick);
+	/* Stops (or restarts) the device asking for audio, e.g. while the game is paused */
+	void setPaused(bool paused);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(Mixer);
+
+	struct Voice {
+		const Sound *sound;
+		int position; // negative while waiting to start, so sounds can begin part-way into a buffer
+	};
+
+	SDL_AudioDeviceID device;
+	SDL_AudioSpec spec;
+	int samplesPerTick;
+	Sound sounds[static_cast<int>(SoundId::Count)];
+	SpscQueue<SoundEvent, MIXER_QUEUE_SIZE> queue;
+
+	// only touched by the audio callback
+	Voice voices[MIXER_MAX_VOICES];
+	Sint32 mixBuffer[MIXER_MAX_BUFFER_SAMPLES];
+
+	void loadSound(SoundId id, const char *file, int toneFrequency, int durationMs);
+	void synthesizeTone(Sound &sound, int toneFrequency, int durationMs);
+	void mix(Sint16 *out, int frames);
+
+	static void SDLCALL audioCallback(void *userdata, Uint8 *stream, int len);
+};
+
+#endif
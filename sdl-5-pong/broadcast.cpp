@@ -0,0 +1,504 @@
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+#include <SDL.h>
+#include <SDL_net.h>
+
+#include "broadcast.h"
+#include "util.h"
+
+#define BROADCAST_KEEPALIVE_MS 1000
+#define SPECTATOR_DELAY_TICKS (BROADCAST_TICKS_PER_SEND * 2.0f) // play back this far behind the newest snapshot
+#define SPECTATOR_DRIFT 0.1f // how much faster or slower than the game to play while getting back to that delay
+
+static Sint32 quantize(float value) {
+	return static_cast<Sint32>(std::floor(value * POSITION_QUANTISATION + 0.5f));
+}
+
+static float dequantize(Sint32 value) {
+	return value / POSITION_QUANTISATION;
+}
+
+QuantizedState QuantizedState::fromWorldState(const WorldState &state, float timeScale) {
+	QuantizedState quantized;
+	quantized.seq = 0;
+	quantized.tick = state.tick;
+	quantized.timeScale = static_cast<Uint16>(timeScale * TIME_SCALE_QUANTISATION + 0.5f);
+	quantized.fields[0] = quantize(state.human.pos.x);
+	quantized.fields[1] = quantize(state.human.pos.y);
+	quantized.fields[2] = quantize(state.opponent.pos.x);
+	quantized.fields[3] = quantize(state.opponent.pos.y);
+	quantized.fields[4] = quantize(state.ball.pos.x);
+	quantized.fields[5] = quantize(state.ball.pos.y);
+	quantized.fields[6] = state.humanScore;
+	quantized.fields[7] = state.opponentScore;
+	return quantized;
+}
+
+void QuantizedState::toWorldState(WorldState &state) const {
+	state.tick = this->tick;
+	state.human.pos.x = dequantize(this->fields[0]);
+	state.human.pos.y = dequantize(this->fields[1]);
+	state.opponent.pos.x = dequantize(this->fields[2]);
+	state.opponent.pos.y = dequantize(this->fields[3]);
+	state.ball.pos.x = dequantize(this->fields[4]);
+	state.ball.pos.y = dequantize(this->fields[5]);
+	state.humanScore = this->fields[6];
+	state.opponentScore = this->fields[7];
+}
+
+static float timeScaleOf(const QuantizedState &state) {
+	return state.timeScale / TIME_SCALE_QUANTISATION;
+}
+
+// A sped up game sends its snapshots less often in real time than in ticks (it still sends at most one per
+// frame), so the delay has to grow with it to always have a snapshot ahead to interpolate towards
+static float playbackDelayTicks(const QuantizedState &latest) {
+	const float timeScale = timeScaleOf(latest);
+	return SPECTATOR_DELAY_TICKS * (timeScale > 1.0f ? timeScale : 1.0f);
+}
+
+static QuantizedState emptyQuantizedState() {
+	QuantizedState empty;
+	std::memset(&empty, 0, sizeof(empty));
+	return empty;
+}
+
+// zigzag varints: small deltas of either sign take a single byte
+static int writeVarint(Sint32 value, Uint8 *out) {
+	Uint32 zigzag = (static_cast<Uint32>(value) << 1) ^ static_cast<Uint32>(value >> 31);
+	int length = 0;
+	while (zigzag >= 0x80) {
+		out[length++] = static_cast<Uint8>(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	out[length++] = static_cast<Uint8>(zigzag);
+	return length;
+}
+
+// returns the number of bytes read, or 0 if the input ran out
+static int readVarint(const Uint8 *in, int available, Sint32 &value) {
+	Uint32 zigzag = 0;
+	for (int i = 0; i < available && i < 5; ++i) {
+		zigzag |= static_cast<Uint32>(in[i] & 0x7F) << (7 * i);
+		if ((in[i] & 0x80) == 0) {
+			value = static_cast<Sint32>(zigzag >> 1) ^ -static_cast<Sint32>(zigzag & 1);
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+static int encodeDelta(const QuantizedState &baseline, const QuantizedState &state, Uint8 *out) {
+	out[0] = 'D';
+	SDLNet_Write32(state.seq, out + 1);
+	SDLNet_Write32(baseline.seq, out + 5);
+	SDLNet_Write32(state.tick, out + 9);
+	SDLNet_Write16(state.timeScale, out + 13);
+	Uint8 &mask = out[15];
+	mask = 0;
+	int length = BROADCAST_DELTA_HEADER;
+	for (int i = 0; i < BROADCAST_FIELDS; ++i) {
+		const Sint32 delta = state.fields[i] - baseline.fields[i];
+		if (delta != 0) {
+			mask |= 1 << i;
+			length += writeVarint(delta, out + length);
+		}
+	}
+	return length;
+}
+
+// the caller has already looked up the baseline named in the packet header
+static bool decodeDelta(const Uint8 *in, int length, const QuantizedState &baseline, QuantizedState &state) {
+	if (length < BROADCAST_DELTA_HEADER) {
+		return false;
+	}
+	state.seq = SDLNet_Read32(in + 1);
+	state.tick = SDLNet_Read32(in + 9);
+	state.timeScale = SDLNet_Read16(in + 13);
+	const Uint8 mask = in[15];
+	int offset = BROADCAST_DELTA_HEADER;
+	for (int i = 0; i < BROADCAST_FIELDS; ++i) {
+		state.fields[i] = baseline.fields[i];
+		if (mask & (1 << i)) {
+			Sint32 delta;
+			const int read = readVarint(in + offset, length - offset, delta);
+			if (read == 0) {
+				return false;
+			}
+			state.fields[i] += delta;
+			offset += read;
+		}
+	}
+	return true;
+}
+
+SpectatorFeed::SpectatorFeed(const char *relayHost, Uint16 port) {
+	this->socket = SDLNet_UDP_Open(0);
+	if (this->socket == nullptr) {
+		logSDLError("SDLNet_UDP_Open");
+	}
+	this->packet = SDLNet_AllocPacket(BROADCAST_FEED_PACKET);
+	if (this->packet == nullptr) {
+		logSDLError("SDLNet_AllocPacket");
+	}
+	if (SDLNet_ResolveHost(&this->packet->address, relayHost, port) != 0) {
+		logSDLError("SDLNet_ResolveHost");
+	}
+	this->lastSubmittedTick = 0;
+	std::cout << "Broadcasting to the spectator relay at " << relayHost << ":" << port << std::endl;
+}
+
+SpectatorFeed::~SpectatorFeed() {
+	SDLNet_FreePacket(this->packet);
+	SDLNet_UDP_Close(this->socket);
+}
+
+void SpectatorFeed::submit(const WorldState &state, float timeScale) {
+	if (state.tick - this->lastSubmittedTick < BROADCAST_TICKS_PER_SEND) {
+		return;
+	}
+	this->lastSubmittedTick = state.tick;
+
+	const QuantizedState quantized = QuantizedState::fromWorldState(state, timeScale);
+	Uint8 *data = this->packet->data;
+	data[0] = 'F';
+	SDLNet_Write32(quantized.tick, data + 1);
+	SDLNet_Write16(quantized.timeScale, data + 5);
+	for (int i = 0; i < BROADCAST_FIELDS; ++i) {
+		SDLNet_Write32(static_cast<Uint32>(quantized.fields[i]), data + 7 + i * 4);
+	}
+	this->packet->len = BROADCAST_FEED_PACKET;
+	// a UDP send to localhost doesn't block, and if the relay isn't running the packet is simply dropped
+	SDLNet_UDP_Send(this->socket, -1, this->packet);
+}
+
+SpectatorRelay::SpectatorRelay(Uint16 port) {
+	this->socket = SDLNet_UDP_Open(port);
+	if (this->socket == nullptr) {
+		logSDLError("SDLNet_UDP_Open");
+	}
+	this->socketSet = SDLNet_AllocSocketSet(1);
+	if (this->socketSet == nullptr) {
+		logSDLError("SDLNet_AllocSocketSet");
+	}
+	SDLNet_UDP_AddSocket(this->socketSet, this->socket);
+	this->packet = SDLNet_AllocPacket(BROADCAST_MAX_PACKET);
+	if (this->packet == nullptr) {
+		logSDLError("SDLNet_AllocPacket");
+	}
+
+	this->nextSeq = 1;
+	this->encodedCount = 0;
+	for (int i = 0; i < BROADCAST_HISTORY; ++i) {
+		this->history[i] = emptyQuantizedState();
+	}
+	this->subscribers.reserve(BROADCAST_MAX_SUBSCRIBERS);
+	this->subscriberIndices.reserve(BROADCAST_MAX_SUBSCRIBERS);
+	std::cout << "Relaying to spectators on port " << port << std::endl;
+}
+
+SpectatorRelay::~SpectatorRelay() {
+	SDLNet_FreePacket(this->packet);
+	SDLNet_FreeSocketSet(this->socketSet);
+	SDLNet_UDP_Close(this->socket);
+}
+
+void SpectatorRelay::run(Uint32 durationMs) {
+	const Uint32 started = SDL_GetTicks();
+	Uint32 lastExpiry = started;
+	bool quit = false;
+	while (!quit) {
+		// sleep until the game or a spectator sends something. While the game is paused nothing arrives,
+		// so this only wakes once a keepalive period to let spectators time out
+		if (SDLNet_CheckSockets(this->socketSet, BROADCAST_KEEPALIVE_MS) > 0) {
+			receive();
+		}
+
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT) {
+				quit = true;
+			}
+		}
+
+		const Uint32 now = SDL_GetTicks();
+		if (now - lastExpiry > BROADCAST_KEEPALIVE_MS) {
+			lastExpiry = now;
+			expireSubscribers(now);
+		}
+		if (durationMs != 0 && now - started >= durationMs) {
+			quit = true;
+		}
+	}
+}
+
+Uint64 SpectatorRelay::addressKey(const IPaddress &address) {
+	return (static_cast<Uint64>(address.host) << 16) | address.port;
+}
+
+SpectatorRelay::Subscriber *SpectatorRelay::findSubscriber(const IPaddress &address) {
+	std::unordered_map<Uint64, size_t>::const_iterator found = this->subscriberIndices.find(addressKey(address));
+	return found != this->subscriberIndices.end() ? &this->subscribers[found->second] : nullptr;
+}
+
+void SpectatorRelay::removeSubscriber(size_t index) {
+	this->subscriberIndices.erase(addressKey(this->subscribers[index].address));
+	if (index + 1 != this->subscribers.size()) {
+		this->subscribers[index] = this->subscribers.back();
+		this->subscriberIndices[addressKey(this->subscribers[index].address)] = index;
+	}
+	this->subscribers.pop_back();
+}
+
+void SpectatorRelay::expireSubscribers(Uint32 now) {
+	for (size_t i = 0; i < this->subscribers.size();) {
+		if (now - this->subscribers[i].lastHeardFrom > BROADCAST_TIMEOUT_MS) {
+			removeSubscriber(i);
+			std::cout << "Spectator timed out; " << this->subscribers.size() << " remaining" << std::endl;
+		} else {
+			++i;
+		}
+	}
+}
+
+void SpectatorRelay::receive() {
+	while (SDLNet_UDP_Recv(this->socket, this->packet) > 0) {
+		if (this->packet->len < 1) {
+			continue;
+		}
+		const Uint8 command = this->packet->data[0];
+		if (command == 'F') {
+			if (this->packet->len >= BROADCAST_FEED_PACKET) {
+				QuantizedState state;
+				state.tick = SDLNet_Read32(this->packet->data + 1);
+				state.timeScale = SDLNet_Read16(this->packet->data + 5);
+				for (int i = 0; i < BROADCAST_FIELDS; ++i) {
+					state.fields[i] = static_cast<Sint32>(SDLNet_Read32(this->packet->data + 7 + i * 4));
+				}
+				relay(state); // reuses this->packet to send
+			}
+			continue;
+		}
+
+		Subscriber *subscriber = findSubscriber(this->packet->address);
+		if (command == 'S' && subscriber == nullptr) {
+			if (this->subscribers.size() >= BROADCAST_MAX_SUBSCRIBERS) {
+				continue;
+			}
+			Subscriber added = { this->packet->address, 0, SDL_GetTicks() };
+			this->subscriberIndices[addressKey(added.address)] = this->subscribers.size();
+			this->subscribers.push_back(added);
+			std::cout << "Spectator joined; " << this->subscribers.size() << " watching" << std::endl;
+		} else if (subscriber == nullptr) {
+			continue;
+		} else if (command == 'S') {
+			subscriber->lastHeardFrom = SDL_GetTicks();
+		} else if (command == 'A' && this->packet->len >= 5) {
+			const Uint32 seq = SDLNet_Read32(this->packet->data + 1);
+			if (seq < this->nextSeq && seq > subscriber->ackedSeq) {
+				subscriber->ackedSeq = seq;
+			}
+			subscriber->lastHeardFrom = SDL_GetTicks();
+		} else if (command == 'U') {
+			removeSubscriber(static_cast<size_t>(subscriber - &this->subscribers[0]));
+			std::cout << "Spectator left; " << this->subscribers.size() << " watching" << std::endl;
+		}
+	}
+}
+
+void SpectatorRelay::relay(QuantizedState &state) {
+	state.seq = this->nextSeq++;
+	if (this->nextSeq == 0) {
+		this->nextSeq = 1; // 0 is reserved for "no baseline"
+	}
+	this->history[state.seq & (BROADCAST_HISTORY - 1)] = state;
+	send(state);
+}
+
+const SpectatorRelay::EncodedPacket &SpectatorRelay::encodeFor(const QuantizedState &state, Uint32 baselineSeq) {
+	for (int i = 0; i < this->encodedCount; ++i) {
+		if (this->encoded[i].baselineSeq == baselineSeq) {
+			return this->encoded[i];
+		}
+	}
+
+	const QuantizedState &baseline = baselineSeq == 0
+		? emptyQuantizedState()
+		: this->history[baselineSeq & (BROADCAST_HISTORY - 1)];
+	EncodedPacket &packet = this->encoded[this->encodedCount++];
+	packet.baselineSeq = baselineSeq;
+	packet.length = encodeDelta(baseline, state, packet.data);
+	return packet;
+}
+
+void SpectatorRelay::send(const QuantizedState &state) {
+	// at most one encoding per distinct baseline, shared by every spectator using that baseline
+	this->encodedCount = 0;
+	for (size_t i = 0; i < this->subscribers.size(); ++i) {
+		Subscriber &subscriber = this->subscribers[i];
+		Uint32 baselineSeq = subscriber.ackedSeq;
+		if (baselineSeq != 0 && (state.seq - baselineSeq >= BROADCAST_HISTORY
+				|| this->history[baselineSeq & (BROADCAST_HISTORY - 1)].seq != baselineSeq)) {
+			baselineSeq = 0; // too old to still have; send a full snapshot
+		}
+
+		const EncodedPacket &encoded = encodeFor(state, baselineSeq);
+		std::memcpy(this->packet->data, encoded.data, encoded.length);
+		this->packet->len = encoded.length;
+		this->packet->address = subscriber.address;
+		SDLNet_UDP_Send(this->socket, -1, this->packet);
+	}
+}
+
+SpectatorClient::SpectatorClient(const char *host, Uint16 port) {
+	if (SDLNet_ResolveHost(&this->server, host, port) != 0) {
+		logSDLError("SDLNet_ResolveHost");
+	}
+	this->socket = SDLNet_UDP_Open(0);
+	if (this->socket == nullptr) {
+		logSDLError("SDLNet_UDP_Open");
+	}
+	this->packet = SDLNet_AllocPacket(BROADCAST_MAX_PACKET);
+	if (this->packet == nullptr) {
+		logSDLError("SDLNet_AllocPacket");
+	}
+	for (int i = 0; i < BROADCAST_HISTORY; ++i) {
+		this->received[i] = emptyQuantizedState();
+	}
+	this->latestSeq = 0;
+	this->playbackTick = 0;
+
+	sendCommand('S', 0);
+	this->lastKeepalive = SDL_GetTicks();
+	std::cout << "Spectating " << host << ":" << port << std::endl;
+}
+
+SpectatorClient::~SpectatorClient() {
+	sendCommand('U', 0);
+	SDLNet_FreePacket(this->packet);
+	SDLNet_UDP_Close(this->socket);
+}
+
+void SpectatorClient::sendCommand(Uint8 command, Uint32 seq) {
+	this->packet->data[0] = command;
+	this->packet->len = 1;
+	if (command == 'A') {
+		SDLNet_Write32(seq, this->packet->data + 1);
+		this->packet->len = 5;
+	}
+	this->packet->address = this->server;
+	SDLNet_UDP_Send(this->socket, -1, this->packet);
+}
+
+void SpectatorClient::poll() {
+	while (SDLNet_UDP_Recv(this->socket, this->packet) > 0) {
+		if (this->packet->len >= 1 && this->packet->data[0] == 'D') {
+			Uint8 data[BROADCAST_MAX_PACKET];
+			const int length = this->packet->len;
+			std::memcpy(data, this->packet->data, length);
+			handleSnapshot(data, length); // reuses this->packet to ack
+		}
+	}
+
+	const Uint32 now = SDL_GetTicks();
+	if (now - this->lastKeepalive > BROADCAST_KEEPALIVE_MS) {
+		sendCommand('S', 0);
+		this->lastKeepalive = now;
+	}
+}
+
+void SpectatorClient::handleSnapshot(const Uint8 *data, int length) {
+	if (length < BROADCAST_DELTA_HEADER) {
+		return;
+	}
+	const Uint32 baselineSeq = SDLNet_Read32(data + 5);
+	QuantizedState baseline = emptyQuantizedState();
+	if (baselineSeq != 0) {
+		baseline = this->received[baselineSeq & (BROADCAST_HISTORY - 1)];
+		if (baseline.seq != baselineSeq) {
+			return; // we've lost track of that baseline; acks for newer snapshots will sort it out
+		}
+	}
+
+	QuantizedState state;
+	if (!decodeDelta(data, length, baseline, state)) {
+		return;
+	}
+	this->received[state.seq & (BROADCAST_HISTORY - 1)] = state;
+	if (state.seq > this->latestSeq) {
+		if (this->latestSeq == 0) {
+			this->playbackTick = state.tick - playbackDelayTicks(state);
+		}
+		this->latestSeq = state.seq;
+	}
+	sendCommand('A', state.seq);
+}
+
+bool SpectatorClient::hasState() const {
+	return this->latestSeq != 0;
+}
+
+void SpectatorClient::interpolate(float deltaTime, WorldState &state) {
+	if (!hasState()) {
+		return;
+	}
+	const QuantizedState &latest = this->received[this->latestSeq & (BROADCAST_HISTORY - 1)];
+	const float latestTick = static_cast<float>(latest.tick);
+	const float delayTicks = playbackDelayTicks(latest);
+
+	// play at the speed the game is running at, nudged towards being delayTicks behind it
+	float rate = timeScaleOf(latest);
+	const float lag = latestTick - this->playbackTick;
+	if (lag < delayTicks) {
+		rate *= 1.0f - SPECTATOR_DRIFT;
+	} else if (lag > delayTicks * 2) {
+		rate *= 1.0f + SPECTATOR_DRIFT;
+	}
+	this->playbackTick += rate * deltaTime / PHYSICS_TIMESTEP;
+	if (this->playbackTick > latestTick) {
+		this->playbackTick = latestTick; // starved; hold the last frame
+	} else if (this->playbackTick < latestTick - delayTicks * 4) {
+		this->playbackTick = latestTick - delayTicks; // fell too far behind; skip ahead
+	}
+
+	// find the snapshots either side of the playback time
+	const QuantizedState *before = nullptr;
+	const QuantizedState *after = nullptr;
+	for (int i = 0; i < BROADCAST_HISTORY; ++i) {
+		const QuantizedState &candidate = this->received[i];
+		if (candidate.seq == 0) {
+			continue;
+		}
+		const float tick = static_cast<float>(candidate.tick);
+		if (tick <= this->playbackTick) {
+			if (before == nullptr || candidate.tick > before->tick) {
+				before = &candidate;
+			}
+		} else if (after == nullptr || candidate.tick < after->tick) {
+			after = &candidate;
+		}
+	}
+	if (before == nullptr) {
+		before = after;
+	}
+	if (after == nullptr) {
+		after = before;
+	}
+
+	WorldState start = state;
+	WorldState finish = state;
+	before->toWorldState(start);
+	after->toWorldState(finish);
+	const float progress = after->tick == before->tick ? 0.0f
+		: (this->playbackTick - before->tick) / static_cast<float>(after->tick - before->tick);
+	WorldState lerped = WorldState::lerpBetween(start, finish, progress);
+
+	state.tick = start.tick;
+	state.human.pos = lerped.human.pos;
+	state.opponent.pos = lerped.opponent.pos;
+	state.ball.pos = lerped.ball.pos;
+	state.humanScore = start.humanScore;
+	state.opponentScore = start.opponentScore;
+}
@@ -0,0 +1,168 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <vector>
+#include <unordered_map>
+
+#include <SDL.h>
+#include <SDL_net.h>
+
+#include "util.h"
+#include "world.h"
+
+#define BROADCAST_DEFAULT_PORT 7777
+#define BROADCAST_HISTORY 64 // snapshots kept for use as delta baselines; must be a power of two
+#define BROADCAST_FIELDS 8
+#define BROADCAST_MAX_PACKET 64
+#define BROADCAST_FEED_PACKET (7 + BROADCAST_FIELDS * 4)
+#define BROADCAST_DELTA_HEADER 16 // bytes before the varints in a 'D' packet
+#define BROADCAST_TICKS_PER_SEND 3 // ~33 snapshots a second at the default timestep
+#define BROADCAST_TIMEOUT_MS 5000 // spectators which haven't been heard from in this long are dropped
+#define BROADCAST_MAX_SUBSCRIBERS 1024
+#define POSITION_QUANTISATION 4.0f // positions are sent in quarter pixels
+#define TIME_SCALE_QUANTISATION 256.0f // time scales are sent in 256ths
+
+/*
+* Wire protocol (all integers big endian, all over UDP):
+*
+* game -> relay
+*   'F' u32 tick u16 timeScale {s32 field}*    one whole quantised snapshot, every BROADCAST_TICKS_PER_SEND ticks
+*
+* spectator -> relay
+*   'S'              subscribe; also serves as a keepalive
+*   'A' u32 seq      acknowledge receipt of snapshot seq, making it eligible as a delta baseline
+*   'U'              unsubscribe
+*
+* relay -> spectator
+*   'D' u32 seq u32 baselineSeq u32 tick u16 timeScale u8 changedMask {varint delta}*
+*     Each set bit in changedMask is followed by the zigzag varint encoded difference between that
+*     field and the same field in the baseline. A baselineSeq of 0 means "relative to all zeroes".
+*     timeScale is how fast the game was running, so spectators can play it back at the same speed.
+*/
+
+/* A WorldState reduced to what spectators need to see, with positions quantised to integers */
+struct QuantizedState {
+	Uint32 seq; // 0 means "no snapshot"
+	Uint32 tick;
+	Uint16 timeScale; // game seconds per real second, in TIME_SCALE_QUANTISATION ths
+	Sint32 fields[BROADCAST_FIELDS];
+
+	static QuantizedState fromWorldState(const WorldState &state, float timeScale);
+	/* overwrites positions and scores in state, leaving sizes alone */
+	void toWorldState(WorldState &state) const;
+};
+
+/**
+* The game's end of broadcasting. Every few ticks it quantises the state and sends it, whole, to a
+* SpectatorRelay: one small packet, whether nobody is watching or hundreds are. Delta encoding, spectator
+* bookkeeping and fan-out all happen in the relay's process, so spectators cost the player nothing.
+*/
+class SpectatorFeed {
+public:
+	SpectatorFeed(const char *relayHost, Uint16 port);
+	~SpectatorFeed();
+
+	/**
+	* Call from the game thread after simulating. Cheap; never blocks.
+	* @param timeScale how fast the game is running (game seconds per real second)
+	*/
+	void submit(const WorldState &state, float timeScale);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(SpectatorFeed);
+	UDPsocket socket;
+	UDPpacket *packet;
+	Uint32 lastSubmittedTick;
+};
+
+/**
+* Fans a game's SpectatorFeed out to spectators, as a process of its own. It sleeps until a packet
+* arrives, so it does nothing while the game is paused or nobody is watching.
+*
+* Each spectator gets deltas against the newest snapshot it has acknowledged. Spectators which share a
+* baseline (which in practice is almost all of them) share a single encoded packet, so the cost of adding
+* a spectator is little more than one sendto().
+*/
+class SpectatorRelay {
+public:
+	explicit SpectatorRelay(Uint16 port);
+	~SpectatorRelay();
+
+	/**
+	* Runs until the process is asked to quit.
+	* @param durationMs stop after this long, or 0 to run indefinitely
+	*/
+	void run(Uint32 durationMs);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(SpectatorRelay);
+
+	struct Subscriber {
+		IPaddress address;
+		Uint32 ackedSeq;
+		Uint32 lastHeardFrom;
+	};
+
+	struct EncodedPacket {
+		Uint32 baselineSeq;
+		int length;
+		Uint8 data[BROADCAST_MAX_PACKET];
+	};
+
+	UDPsocket socket;
+	SDLNet_SocketSet socketSet;
+	UDPpacket *packet;
+	std::vector<Subscriber> subscribers;
+	std::unordered_map<Uint64, size_t> subscriberIndices; // keyed by addressKey()
+	QuantizedState history[BROADCAST_HISTORY];
+	Uint32 nextSeq;
+	EncodedPacket encoded[BROADCAST_HISTORY + 1];
+	int encodedCount;
+
+	static Uint64 addressKey(const IPaddress &address);
+	void receive();
+	void relay(QuantizedState &state);
+	void send(const QuantizedState &state);
+	const EncodedPacket &encodeFor(const QuantizedState &state, Uint32 baselineSeq);
+	Subscriber *findSubscriber(const IPaddress &address);
+	void removeSubscriber(size_t index);
+	void expireSubscribers(Uint32 now);
+};
+
+/**
+* Receives snapshots from a SpectatorRelay and plays them back smoothly, slightly behind real
+* time, by interpolating between them with WorldState::lerpBetween.
+*/
+class SpectatorClient {
+public:
+	SpectatorClient(const char *host, Uint16 port);
+	~SpectatorClient();
+
+	/* Receive and acknowledge everything that has arrived, and keep the subscription alive. Never blocks. */
+	void poll();
+
+	/* @return false until the first snapshot has arrived */
+	bool hasState() const;
+
+	/**
+	* Advances the playback clock and fills in state with positions and scores for the new time.
+	* @param deltaTime real seconds elapsed since the last call
+	* @param state receives the interpolated state (sizes are left untouched)
+	*/
+	void interpolate(float deltaTime, WorldState &state);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(SpectatorClient);
+	UDPsocket socket;
+	IPaddress server;
+	UDPpacket *packet;
+	QuantizedState received[BROADCAST_HISTORY];
+	Uint32 latestSeq;
+	Uint32 lastKeepalive;
+	float playbackTick;
+
+	void sendCommand(Uint8 command, Uint32 seq);
+	void handleSnapshot(const Uint8 *data, int length);
+};
+
+#endif
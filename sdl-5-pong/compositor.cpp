@@ -0,0 +1,415 @@
+#include <iostream>
+#include <cstring>
+
+#include <SDL.h>
+#include <SDL_image.h>
+
+#include "compositor.h"
+#include "util.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// SDL only learned to detect AVX2 in 2.0.4, and MSVC only learned its intrinsics in 2013
+#if defined(COMPOSITOR_SSE2) && SDL_VERSION_ATLEAST(2, 0, 4) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+#define COMPOSITOR_AVX2
+#include <immintrin.h>
+#ifdef __GNUC__
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+#endif
+
+Sprite::Sprite(const std::string &file) {
+	this->name = file;
+	SDL_Surface *loaded = IMG_Load(file.c_str());
+	if (loaded == nullptr) {
+		logSDLError("IMG_Load");
+	}
+	copyPixels(loaded);
+	SDL_FreeSurface(loaded);
+}
+
+Sprite::Sprite(const std::string &name, SDL_Surface *surface) {
+	this->name = name;
+	copyPixels(surface);
+}
+
+void Sprite::copyPixels(SDL_Surface *surface) {
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+	if (converted == nullptr) {
+		logSDLError("SDL_ConvertSurfaceFormat");
+	}
+
+	this->width = converted->w;
+	this->height = converted->h;
+	this->pixels = new Uint32[this->width * this->height];
+	this->opaque = true;
+	if (SDL_MUSTLOCK(converted) && SDL_LockSurface(converted) != 0) {
+		logSDLError("SDL_LockSurface");
+	}
+	for (int y = 0; y < this->height; ++y) {
+		const Uint32 *row = reinterpret_cast<const Uint32 *>(static_cast<const Uint8 *>(converted->pixels) + y * converted->pitch);
+		for (int x = 0; x < this->width; ++x) {
+			this->pixels[y * this->width + x] = row[x];
+			if ((row[x] >> 24) != 0xFF) {
+				this->opaque = false;
+			}
+		}
+	}
+	if (SDL_MUSTLOCK(converted)) {
+		SDL_UnlockSurface(converted);
+	}
+	SDL_FreeSurface(converted);
+}
+
+Sprite::Sprite(const Sprite &original, int width, int height) {
+	this->name = original.name;
+	this->width = width > 0 ? width : 1;
+	this->height = height > 0 ? height : 1;
+	this->pixels = new Uint32[this->width * this->height];
+	this->opaque = original.opaque;
+	for (int y = 0; y < this->height; ++y) {
+		const Uint32 *row = original.pixels + (y * original.height / this->height) * original.width;
+		for (int x = 0; x < this->width; ++x) {
+			this->pixels[y * this->width + x] = row[x * original.width / this->width];
+		}
+	}
+}
+
+Sprite::~Sprite() {
+	delete[] this->pixels;
+}
+
+// src over dst, where dst is opaque: out = (src * a + dst * (255 - a)) / 255 per channel
+static void blendRowScalar(Uint32 *dst, const Uint32 *src, int count) {
+	for (int i = 0; i < count; ++i) {
+		const Uint32 s = src[i];
+		const Uint32 a = s >> 24;
+		if (a == 0) {
+			continue;
+		} else if (a == 0xFF) {
+			dst[i] = s;
+			continue;
+		}
+		const Uint32 d = dst[i];
+		Uint32 rb = (s & 0xFF00FF) * a + (d & 0xFF00FF) * (255 - a) + 0x800080;
+		rb = ((rb + ((rb >> 8) & 0xFF00FF)) >> 8) & 0xFF00FF;
+		Uint32 g = (s & 0xFF00) * a + (d & 0xFF00) * (255 - a) + 0x8000;
+		g = ((g + ((g >> 8) & 0xFF00)) >> 8) & 0xFF00;
+		dst[i] = 0xFF000000 | rb | g;
+	}
+}
+
+#ifdef COMPOSITOR_SSE2
+// blends 2 pixels unpacked into 16 bit lanes
+static inline __m128i blendUnpackedSse2(__m128i s, __m128i d) {
+	const __m128i all255 = _mm_set1_epi16(255);
+	const __m128i half = _mm_set1_epi16(128);
+	__m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i result = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(all255, a)));
+	result = _mm_add_epi16(result, half);
+	return _mm_srli_epi16(_mm_add_epi16(result, _mm_srli_epi16(result, 8)), 8); // divide by 255
+}
+
+static void blendRowSse2(Uint32 *dst, const Uint32 *src, int count) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		const __m128i alpha = _mm_and_si128(s, alphaMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF) {
+			continue; // all transparent, which is most of the HUD
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xFFFF) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s);
+			continue;
+		}
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		const __m128i lo = blendUnpackedSse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+		const __m128i hi = blendUnpackedSse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), alphaMask));
+	}
+	blendRowScalar(dst + i, src + i, count - i);
+}
+#endif
+
+#ifdef COMPOSITOR_AVX2
+AVX2_FUNCTION static inline __m256i blendUnpackedAvx2(__m256i s, __m256i d) {
+	const __m256i all255 = _mm256_set1_epi16(255);
+	const __m256i half = _mm256_set1_epi16(128);
+	__m256i a = _mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	__m256i result = _mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, _mm256_sub_epi16(all255, a)));
+	result = _mm256_add_epi16(result, half);
+	return _mm256_srli_epi16(_mm256_add_epi16(result, _mm256_srli_epi16(result, 8)), 8);
+}
+
+AVX2_FUNCTION static void blendRowAvx2(Uint32 *dst, const Uint32 *src, int count) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+		const __m256i alpha = _mm256_and_si256(s, alphaMask);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, zero)) == -1) {
+			continue;
+		}
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alphaMask)) == -1) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), s);
+			continue;
+		}
+		const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+		// unpack and pack both work within 128 bit lanes, so pixels come back out in the right order
+		const __m256i lo = blendUnpackedAvx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+		const __m256i hi = blendUnpackedAvx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), alphaMask));
+	}
+#ifdef COMPOSITOR_SSE2
+	blendRowSse2(dst + i, src + i, count - i);
+#else
+	blendRowScalar(dst + i, src + i, count - i);
+#endif
+}
+#endif
+
+Compositor::Compositor(SDL_Renderer *renderer, int width, int height) {
+	this->renderer = renderer;
+	this->width = width;
+	this->height = height;
+	this->framebuffer = new Uint32[width * height];
+	std::memset(this->framebuffer, 0, width * height * sizeof(Uint32));
+	this->drawnCount = 0;
+	this->previouslyDrawnCount = 0;
+	this->clearEverything = false;
+	createTexture();
+
+	this->blendRow = &blendRowScalar;
+	this->kernelName = "scalar";
+#ifdef COMPOSITOR_SSE2
+	if (SDL_HasSSE2()) {
+		this->blendRow = &blendRowSse2;
+		this->kernelName = "SSE2";
+	}
+#endif
+#ifdef COMPOSITOR_AVX2
+	if (SDL_HasAVX2()) {
+		this->blendRow = &blendRowAvx2;
+		this->kernelName = "AVX2";
+	}
+#endif
+	std::cout << "Compositing on the CPU with " << this->kernelName << " blending" << std::endl;
+}
+
+void Compositor::createTexture() {
+	this->texture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STREAMING, this->width, this->height);
+	if (this->texture == nullptr) {
+		logSDLError("SDL_CreateTexture");
+	}
+	if (SDL_SetTextureBlendMode(this->texture, SDL_BLENDMODE_NONE) != 0) {
+		logSDLError("SDL_SetTextureBlendMode");
+	}
+	this->uploadEverything = true; // the texture starts out with garbage in it
+}
+
+void Compositor::recreateTexture() {
+	SDL_DestroyTexture(this->texture);
+	createTexture();
+}
+
+Compositor::~Compositor() {
+	for (size_t i = 0; i < this->sprites.size(); ++i) {
+		delete this->sprites[i];
+	}
+	for (std::map<Uint64, Sprite *>::iterator i = this->resizedSprites.begin(); i != this->resizedSprites.end(); ++i) {
+		delete i->second;
+	}
+	SDL_DestroyTexture(this->texture);
+	delete[] this->framebuffer;
+}
+
+const char *Compositor::getKernelName() const {
+	return this->kernelName;
+}
+
+size_t Compositor::findSprite(const std::string &file) {
+	for (size_t i = 0; i < this->sprites.size(); ++i) {
+		if (this->sprites[i]->name == file) {
+			return i;
+		}
+	}
+	this->sprites.push_back(new Sprite(file));
+	return this->sprites.size() - 1;
+}
+
+const Sprite *Compositor::loadSprite(const std::string &file) {
+	return this->sprites[findSprite(file)];
+}
+
+const Sprite *Compositor::loadSprite(const std::string &file, int width, int height) {
+	const size_t originalIndex = findSprite(file);
+	const Sprite *original = this->sprites[originalIndex];
+	if (original->width == width && original->height == height) {
+		return original;
+	}
+
+	const Uint64 key = (static_cast<Uint64>(originalIndex) << 32)
+		| (static_cast<Uint64>(width & 0xFFFF) << 16) | static_cast<Uint64>(height & 0xFFFF);
+	std::map<Uint64, Sprite *>::iterator found = this->resizedSprites.find(key);
+	if (found != this->resizedSprites.end()) {
+		return found->second;
+	}
+	Sprite *sprite = new Sprite(*original, width, height);
+	this->resizedSprites[key] = sprite;
+	return sprite;
+}
+
+bool Compositor::clip(SDL_Rect &rect) const {
+	const SDL_Rect bounds = { 0, 0, this->width, this->height };
+	SDL_Rect clipped;
+	if (!SDL_IntersectRect(&rect, &bounds, &clipped)) {
+		return false;
+	}
+	rect = clipped;
+	return true;
+}
+
+void Compositor::markDrawn(const SDL_Rect &rect) {
+	if (this->drawnCount == COMPOSITOR_MAX_DIRTY_RECTS) {
+		this->clearEverything = true;
+		this->uploadEverything = true;
+		return;
+	}
+	this->drawn[this->drawnCount++] = rect;
+}
+
+void Compositor::beginFrame() {
+	if (this->clearEverything) {
+		std::memset(this->framebuffer, 0, this->width * this->height * sizeof(Uint32));
+		this->clearEverything = false;
+		this->uploadEverything = true;
+	} else {
+		for (int i = 0; i < this->drawnCount; ++i) {
+			const SDL_Rect &rect = this->drawn[i];
+			for (int y = rect.y; y < rect.y + rect.h; ++y) {
+				std::memset(this->framebuffer + y * this->width + rect.x, 0, rect.w * sizeof(Uint32));
+			}
+		}
+	}
+	std::memcpy(this->previouslyDrawn, this->drawn, this->drawnCount * sizeof(SDL_Rect));
+	this->previouslyDrawnCount = this->drawnCount;
+	this->drawnCount = 0;
+}
+
+void Compositor::drawSprite(const Sprite *sprite, int x, int y) {
+	SDL_Rect rect = { x, y, sprite->width, sprite->height };
+	if (!clip(rect)) {
+		return;
+	}
+	markDrawn(rect);
+
+	const Uint32 *src = sprite->pixels + (rect.y - y) * sprite->width + (rect.x - x);
+	Uint32 *dst = this->framebuffer + rect.y * this->width + rect.x;
+	for (int row = 0; row < rect.h; ++row) {
+		if (sprite->opaque) {
+			std::memcpy(dst, src, rect.w * sizeof(Uint32));
+		} else {
+			this->blendRow(dst, src, rect.w);
+		}
+		src += sprite->width;
+		dst += this->width;
+	}
+}
+
+void Compositor::fillRect(const SDL_Rect &rect, Uint32 color) {
+	SDL_Rect clipped = rect;
+	if (!clip(clipped)) {
+		return;
+	}
+	markDrawn(clipped);
+
+	Uint32 *dst = this->framebuffer + clipped.y * this->width + clipped.x;
+	for (int row = 0; row < clipped.h; ++row) {
+		for (int x = 0; x < clipped.w; ++x) {
+			dst[x] = color | 0xFF000000;
+		}
+		dst += this->width;
+	}
+}
+
+void Compositor::blendSurface(SDL_Surface *surface, const SDL_Rect &region) {
+	SDL_Rect rect = region;
+	if (rect.x + rect.w > surface->w) {
+		rect.w = surface->w - rect.x;
+	}
+	if (rect.y + rect.h > surface->h) {
+		rect.h = surface->h - rect.y;
+	}
+	if (rect.w <= 0 || rect.h <= 0 || !clip(rect)) {
+		return;
+	}
+	markDrawn(rect);
+
+	if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) != 0) {
+		logSDLError("SDL_LockSurface");
+	}
+	const Uint8 *src = static_cast<const Uint8 *>(surface->pixels) + rect.y * surface->pitch + rect.x * sizeof(Uint32);
+	Uint32 *dst = this->framebuffer + rect.y * this->width + rect.x;
+	for (int row = 0; row < rect.h; ++row) {
+		this->blendRow(dst, reinterpret_cast<const Uint32 *>(src), rect.w);
+		src += surface->pitch;
+		dst += this->width;
+	}
+	if (SDL_MUSTLOCK(surface)) {
+		SDL_UnlockSurface(surface);
+	}
+}
+
+void Compositor::upload(const SDL_Rect &rect) {
+	const Uint32 *pixels = this->framebuffer + rect.y * this->width + rect.x;
+	if (SDL_UpdateTexture(this->texture, &rect, pixels, this->width * sizeof(Uint32)) != 0) {
+		logSDLError("SDL_UpdateTexture");
+	}
+}
+
+void Compositor::present(const SDL_Rect &destination) {
+	if (this->uploadEverything) {
+		const SDL_Rect everything = { 0, 0, this->width, this->height };
+		upload(everything);
+		this->uploadEverything = false;
+	} else {
+		// both what was drawn and what was cleared need uploading; merge overlapping rects (e.g. where a
+		// sprite only moved a little) so nothing is uploaded twice
+		SDL_Rect pending[COMPOSITOR_MAX_DIRTY_RECTS * 2];
+		int pendingCount = 0;
+		for (int i = 0; i < this->drawnCount + this->previouslyDrawnCount; ++i) {
+			SDL_Rect rect = i < this->drawnCount ? this->drawn[i] : this->previouslyDrawn[i - this->drawnCount];
+			bool merged = true;
+			while (merged) {
+				merged = false;
+				for (int j = 0; j < pendingCount; ++j) {
+					if (SDL_HasIntersection(&rect, &pending[j])) {
+						SDL_UnionRect(&rect, &pending[j], &rect);
+						pending[j] = pending[--pendingCount];
+						merged = true;
+						break;
+					}
+				}
+			}
+			pending[pendingCount++] = rect;
+		}
+		for (int i = 0; i < pendingCount; ++i) {
+			upload(pending[i]);
+		}
+	}
+
+	if (SDL_RenderCopy(this->renderer, this->texture, nullptr, &destination) != 0) {
+		logSDLError("SDL_RenderCopy()");
+	}
+}
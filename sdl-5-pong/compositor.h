@@ -0,0 +1,107 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <SDL.h>
+
+#include "util.h"
+
+#define COMPOSITOR_MAX_DIRTY_RECTS 64
+
+/* An image held in system memory as ARGB8888 (straight, i.e. not premultiplied, alpha) */
+class Sprite {
+public:
+	std::string name;
+	Uint32 *pixels;
+	int width;
+	int height;
+	bool opaque; // every pixel has full alpha, so it can be copied rather than blended
+
+	explicit Sprite(const std::string &file);
+	/* a copy of surface (which is left alone), e.g. some rendered text */
+	Sprite(const std::string &name, SDL_Surface *surface);
+	/* a copy of original resized to width x height, using nearest neighbour sampling */
+	Sprite(const Sprite &original, int width, int height);
+	~Sprite();
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(Sprite);
+	void copyPixels(SDL_Surface *surface);
+};
+
+typedef void (*BlendRowFunction)(Uint32 *dst, const Uint32 *src, int count);
+
+/**
+* Alternative to drawing with lots of SDL_RenderCopy calls, for when SDL is using its software renderer:
+* everything is composited into one framebuffer in system memory using SIMD copy and alpha blend
+* kernels (SSE2, or AVX2 where the CPU and SDL support it), and then uploaded as one streaming texture
+* and drawn with a single SDL_RenderCopy.
+*
+* Only regions drawn to this frame or last frame are cleared, composited and uploaded; the rest of the
+* framebuffer (and texture) is left alone.
+*/
+class Compositor {
+public:
+	Compositor(SDL_Renderer *renderer, int width, int height);
+	~Compositor();
+
+	/* @return the sprite for the given image file, loading it the first time it's asked for */
+	const Sprite *loadSprite(const std::string &file);
+	/* @return the sprite for the given image file resized to width x height, resizing it the first time it's asked for */
+	const Sprite *loadSprite(const std::string &file, int width, int height);
+	/* Makes the texture again, after SDL_RENDER_DEVICE_RESET has destroyed it */
+	void recreateTexture();
+
+	/* Clears whatever was drawn last frame. Call before drawing anything each frame. */
+	void beginFrame();
+	void drawSprite(const Sprite *sprite, int x, int y);
+	/* Fills rect with an opaque ARGB8888 color */
+	void fillRect(const SDL_Rect &rect, Uint32 color);
+	/**
+	* Alpha blends part of an ARGB8888 surface onto the frame at the same position.
+	* @param region which part of the surface to blend; it's a waste of time to include transparent areas
+	*/
+	void blendSurface(SDL_Surface *surface, const SDL_Rect &region);
+	/**
+	* Uploads everything that changed and draws the frame with the renderer
+	* @param destination where to draw the frame on the render target; it's stretched to fit
+	*/
+	void present(const SDL_Rect &destination);
+
+	/* @return the name of the blend kernel in use, e.g. "SSE2" */
+	const char *getKernelName() const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(Compositor);
+	SDL_Renderer *renderer;
+	SDL_Texture *texture;
+	int width;
+	int height;
+	Uint32 *framebuffer;
+	std::vector<Sprite *> sprites; // as loaded
+	std::map<Uint64, Sprite *> resizedSprites; // keyed on which of sprites they're a copy of, and their size
+	BlendRowFunction blendRow;
+	const char *kernelName;
+
+	// regions drawn to this frame and last frame: both need uploading, and the latter needs clearing
+	SDL_Rect drawn[COMPOSITOR_MAX_DIRTY_RECTS];
+	int drawnCount;
+	SDL_Rect previouslyDrawn[COMPOSITOR_MAX_DIRTY_RECTS];
+	int previouslyDrawnCount;
+	// set when we lose track of what's been drawn, i.e. when there were more rects than we have room for
+	bool clearEverything;
+	bool uploadEverything;
+
+	// clips rect to the framebuffer, returning false if nothing is left of it
+	bool clip(SDL_Rect &rect) const;
+	void markDrawn(const SDL_Rect &rect);
+	void upload(const SDL_Rect &rect);
+	void createTexture();
+	// the index in sprites of file, loading it if it isn't there yet
+	size_t findSprite(const std::string &file);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef CONTROLLERS_H
+#define CONTROLLERS_H
+
+#include <atomic>
+
+#include <SDL.h>
+
+#include "entities.h"
+#include "util.h"
+#include "world.h"
+
+/*
+* Controller policies decide how fast a paddle should move each tick. They're plain classes with a
+*
+*     float paddleSpeed(const MovingRect &paddle, const MovingRect &ball, Uint32 tick, float timeDelta)
+*
+* member returning the paddle's new vertical speed, so World::update can be instantiated for a
+* particular pair of them and have everything inlined. Wrap one in a PolicyController to choose it at
+* runtime instead.
+*/
+
+/**
+* Moves the paddle with the keyboard: up and down arrows by default. It doesn't touch SDL until it's
+* first asked for a speed, so it's safe to construct before SDL_Init (e.g. as a static).
+*/
+class KeyboardController {
+public:
+	KeyboardController() {
+		this->up = SDL_SCANCODE_UP;
+		this->down = SDL_SCANCODE_DOWN;
+		this->keysDown = nullptr;
+	}
+
+	KeyboardController(SDL_Scancode up, SDL_Scancode down) {
+		this->up = up;
+		this->down = down;
+		this->keysDown = nullptr;
+	}
+
+	float paddleSpeed(const MovingRect &, const MovingRect &, Uint32, float) const {
+		if (this->keysDown == nullptr) {
+			this->keysDown = SDL_GetKeyboardState(nullptr); // SDL keeps this up to date for us
+		}
+		if (this->keysDown[this->up]) {
+			return -PLAYER_SPEED;
+		} else if (this->keysDown[this->down]) {
+			return PLAYER_SPEED;
+		}
+		return 0;
+	}
+
+private:
+	SDL_Scancode up;
+	SDL_Scancode down;
+	mutable const Uint8 *keysDown; // fetched on first use, as SDL only has it once it's initialised
+};
+
+/* Chases the ball: the "ai" */
+class ChaseAiController {
+public:
+	float paddleSpeed(const MovingRect &paddle, const MovingRect &ball, Uint32, float timeDelta) const {
+		const float idealDistanceToCover = ball.getCenter().y - paddle.getCenter().y;
+		const float maxDistance = PLAYER_SPEED * timeDelta;
+		return idealDistanceToCover > maxDistance ? PLAYER_SPEED
+			: idealDistanceToCover < -maxDistance ? -PLAYER_SPEED
+			: 0.0f;
+	}
+};
+
+/* Sweeps up and down on a fixed schedule regardless of the ball, for repeatable benchmarks */
+class ScriptedController {
+public:
+	/* @param periodTicks how many ticks to move in each direction before turning round */
+	explicit ScriptedController(Uint32 periodTicks) {
+		this->periodTicks = periodTicks > 0 ? periodTicks : 1;
+	}
+
+	float paddleSpeed(const MovingRect &, const MovingRect &, Uint32 tick, float) const {
+		return ((tick / this->periodTicks) & 1) != 0 ? -PLAYER_SPEED : PLAYER_SPEED;
+	}
+
+private:
+	Uint32 periodTicks;
+};
+
+/* Plays back previously recorded inputs (-1 up, 1 down, 0 still), one per tick, then stays still */
+class ReplayController {
+public:
+	/* @param inputs not copied, so must outlive the controller */
+	ReplayController(const Sint8 *inputs, Uint32 count, Uint32 firstTick) {
+		this->inputs = inputs;
+		this->count = count;
+		this->firstTick = firstTick;
+	}
+
+	float paddleSpeed(const MovingRect &, const MovingRect &, Uint32 tick, float) const {
+		const Uint32 index = tick - this->firstTick;
+		return index < this->count ? this->inputs[index] * PLAYER_SPEED : 0.0f;
+	}
+
+private:
+	const Sint8 *inputs;
+	Uint32 count;
+	Uint32 firstTick;
+};
+
+/* Follows whatever direction (-1 up, 1 down, 0 still) another thread last wrote, e.g. from the network */
+class ExternalBufferController {
+public:
+	explicit ExternalBufferController(const std::atomic<int> *input) {
+		this->input = input;
+	}
+
+	float paddleSpeed(const MovingRect &, const MovingRect &, Uint32, float) const {
+		return this->input->load(std::memory_order_relaxed) * PLAYER_SPEED;
+	}
+
+private:
+	const std::atomic<int> *input;
+};
+
+/* A controller chosen at runtime */
+class Controller {
+public:
+	virtual ~Controller() {}
+	virtual float paddleSpeed(const MovingRect &paddle, const MovingRect &ball, Uint32 tick, float timeDelta) = 0;
+};
+
+template<typename Policy>
+class PolicyController : public Controller {
+public:
+	PolicyController() {}
+	explicit PolicyController(const Policy &policy) : policy(policy) {}
+
+	virtual float paddleSpeed(const MovingRect &paddle, const MovingRect &ball, Uint32 tick, float timeDelta) override {
+		return this->policy.paddleSpeed(paddle, ball, tick, timeDelta);
+	}
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(PolicyController);
+	Policy policy;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <SDL.h>
+
+#include "display.h"
+#include "util.h"
+
+Display::Display(const char *title, int windowWidth, int windowHeight, int internalWidth, int internalHeight,
+		bool fullscreen, bool software, bool renderToTarget) {
+	this->internalWidth = internalWidth;
+	this->internalHeight = internalHeight;
+	this->fullscreen = fullscreen;
+
+	Uint32 windowFlags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE;
+	if (fullscreen) {
+		windowFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+	}
+	this->window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+		windowWidth, windowHeight, windowFlags);
+	if (this->window == nullptr) {
+		logSDLError("CreateWindow");
+	}
+	//SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	Uint32 rendererFlags = software ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED;
+	if (renderToTarget) {
+		rendererFlags |= SDL_RENDERER_TARGETTEXTURE;
+	}
+	this->renderer = SDL_CreateRenderer(this->window, -1, rendererFlags);
+	if (this->renderer == nullptr) {
+		logSDLError("CreateRenderer");
+	}
+
+	this->target = nullptr;
+	if (renderToTarget) {
+		createTarget();
+	}
+}
+
+Display::~Display() {
+	if (this->target != nullptr) {
+		SDL_DestroyTexture(this->target);
+	}
+	SDL_DestroyRenderer(this->renderer);
+	SDL_DestroyWindow(this->window);
+}
+
+SDL_Renderer *Display::getRenderer() const {
+	return this->renderer;
+}
+
+int Display::getInternalWidth() const {
+	return this->internalWidth;
+}
+
+int Display::getInternalHeight() const {
+	return this->internalHeight;
+}
+
+SDL_Rect Display::getOutputRect() const {
+	int outputWidth;
+	int outputHeight;
+	if (SDL_GetRendererOutputSize(this->renderer, &outputWidth, &outputHeight) != 0) {
+		logSDLError("SDL_GetRendererOutputSize");
+	}
+
+	// compare aspect ratios without dividing: whichever dimension is relatively shorter limits the size
+	SDL_Rect rect;
+	if (outputWidth * this->internalHeight < outputHeight * this->internalWidth) {
+		rect.w = outputWidth;
+		rect.h = outputWidth * this->internalHeight / this->internalWidth;
+	} else {
+		rect.w = outputHeight * this->internalWidth / this->internalHeight;
+		rect.h = outputHeight;
+	}
+	rect.x = (outputWidth - rect.w) / 2;
+	rect.y = (outputHeight - rect.h) / 2;
+	return rect;
+}
+
+void Display::createTarget() {
+	this->target = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_TARGET, this->internalWidth, this->internalHeight);
+	if (this->target == nullptr) {
+		logSDLError("SDL_CreateTexture");
+	}
+}
+
+void Display::recreateTarget() {
+	if (this->target == nullptr) {
+		return;
+	}
+	SDL_DestroyTexture(this->target);
+	createTarget();
+}
+
+void Display::beginFrame() {
+	SDL_assert(this->target != nullptr);
+	if (SDL_SetRenderTarget(this->renderer, this->target) != 0) {
+		logSDLError("SDL_SetRenderTarget");
+	}
+	SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 0);
+	SDL_RenderClear(this->renderer);
+}
+
+void Display::finishFrame() {
+	if (SDL_SetRenderTarget(this->renderer, nullptr) != 0) {
+		logSDLError("SDL_SetRenderTarget");
+	}
+	clearOutput();
+	const SDL_Rect output = getOutputRect();
+	if (SDL_RenderCopy(this->renderer, this->target, nullptr, &output) != 0) {
+		logSDLError("SDL_RenderCopy()");
+	}
+}
+
+void Display::clearOutput() {
+	SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 0);
+	SDL_RenderClear(this->renderer);
+}
+
+void Display::toggleFullscreen() {
+	this->fullscreen = !this->fullscreen;
+	if (SDL_SetWindowFullscreen(this->window, this->fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0) != 0) {
+		// not worth quitting over; carry on in whatever mode we were in
+		this->fullscreen = !this->fullscreen;
+	}
+}
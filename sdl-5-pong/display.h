@@ -0,0 +1,57 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <SDL.h>
+
+#include "util.h"
+
+/**
+* Owns the window and renderer, and decouples the resolution we render at from the size of the window.
+* Frames are drawn at a fixed internal resolution (into a target texture, or by a Compositor) and then
+* scaled up or down to fit the window, keeping their aspect ratio and letterboxing whatever's left over.
+* That way the window can be resized or made fullscreen without changing how much work each frame is.
+*/
+class Display {
+public:
+	/**
+	* @param windowWidth the initial size of the window (the window is resizable)
+	* @param internalWidth the size of the frames we render
+	* @param fullscreen start in fullscreen (at the desktop's resolution) rather than windowed
+	* @param software use SDL's software renderer rather than an accelerated one
+	* @param renderToTarget whether frames will be drawn with beginFrame and finishFrame; if not (because a
+	* Compositor draws them) there's no need for a target texture
+	*/
+	Display(const char *title, int windowWidth, int windowHeight, int internalWidth, int internalHeight,
+		bool fullscreen, bool software, bool renderToTarget);
+	~Display();
+
+	SDL_Renderer *getRenderer() const;
+	int getInternalWidth() const;
+	int getInternalHeight() const;
+	/* @return where on the window the frame goes: as large as fits at the internal aspect ratio, centered */
+	SDL_Rect getOutputRect() const;
+
+	/* Points the renderer at the internal render target and clears it */
+	void beginFrame();
+	/* Scales the internal render target onto the window; call SDL_RenderPresent afterwards */
+	void finishFrame();
+	/* Clears the window, for when the frame is drawn straight onto it (at getOutputRect) instead */
+	void clearOutput();
+
+	void toggleFullscreen();
+	/* Makes the target texture again, after SDL_RENDER_DEVICE_RESET has destroyed it along with every other texture */
+	void recreateTarget();
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(Display);
+	SDL_Window *window;
+	SDL_Renderer *renderer;
+	SDL_Texture *target; // the internal resolution frame, or nullptr if we aren't rendering to a target
+	int internalWidth;
+	int internalHeight;
+	bool fullscreen;
+
+	void createTarget();
+};
+
+#endif
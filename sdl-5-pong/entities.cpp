@@ -23,6 +23,7 @@ MovingRect MovingRect::lerpBetween(const MovingRect &start, const MovingRect &fi
 	MovingRect lerped;
 	lerped.pos.x = start.pos.x * (1 - progress) + finish.pos.x * progress;
 	lerped.pos.y = start.pos.y * (1 - progress) + finish.pos.y * progress;
+	lerped.size = finish.size;
 	return lerped;
 }
 
@@ -30,54 +31,112 @@ Vector2 getCenter(Vector2 pos, Vector2 size) {
 	return Vector2(pos.x + size.x / 2, pos.y + size.y / 2);
 }
 
-Vector2 MovingRect::getCenter() {
+Vector2 MovingRect::getCenter() const {
 	return ::getCenter(this->pos, this->size);
 }
 
-Player::Player(SDL_Renderer *renderer, MovingRect &state) {
-	this->renderer = renderer;
-	this->tex = loadTexture("paddle.png", renderer);
-	if (this->tex == nullptr) {
+FieldTransform::FieldTransform() {
+	this->scaleX = 1.0f;
+	this->scaleY = 1.0f;
+	this->offsetX = 0;
+	this->offsetY = 0;
+}
+
+FieldTransform::FieldTransform(int fieldWidth, int fieldHeight, const SDL_Rect &viewport) {
+	this->scaleX = static_cast<float>(viewport.w) / fieldWidth;
+	this->scaleY = static_cast<float>(viewport.h) / fieldHeight;
+	this->offsetX = viewport.x;
+	this->offsetY = viewport.y;
+}
+
+SDL_Rect FieldTransform::apply(const MovingRect &rect) const {
+	// round edges rather than sizes, so that adjacent things stay adjacent
+	const int left = static_cast<int>(rect.pos.x * this->scaleX + 0.5f);
+	const int top = static_cast<int>(rect.pos.y * this->scaleY + 0.5f);
+	const int right = static_cast<int>((rect.pos.x + rect.size.x) * this->scaleX + 0.5f);
+	const int bottom = static_cast<int>((rect.pos.y + rect.size.y) * this->scaleY + 0.5f);
+	SDL_Rect pixels = { this->offsetX + left, this->offsetY + top, right - left, bottom - top };
+	return pixels;
+}
+
+void FieldTransform::applySize(const Vector2 &size, int &width, int &height) const {
+	width = static_cast<int>(size.x * this->scaleX + 0.5f);
+	height = static_cast<int>(size.y * this->scaleY + 0.5f);
+}
+
+// sprites are cached by size, so only look one up again if the size we want has changed (which, with the
+// size from FieldTransform::applySize, is only when the transform does)
+static const Sprite *spriteForSize(const Sprite *current, Compositor &compositor, const char *file,
+		const FieldTransform &transform, const MovingRect &rect) {
+	int width;
+	int height;
+	transform.applySize(rect.size, width, height);
+	if (current != nullptr && current->width == width && current->height == height) {
+		return current;
+	}
+	return compositor.loadSprite(file, width, height);
+}
+
+// loads file into a texture, returning its size in width and height
+static SDL_Texture *loadEntityTexture(const char *file, SDL_Renderer *renderer, int &width, int &height) {
+	SDL_Texture *tex = loadTexture(file, renderer);
+	if (tex == nullptr) {
 		logFatal("loadTexture");
 	}
-	int w, h;
-	if (SDL_QueryTexture(this->tex, nullptr, nullptr, &w, &h) != 0) {
+	if (SDL_QueryTexture(tex, nullptr, nullptr, &width, &height) != 0) {
 		logFatal("QueryTexture");
 	}
-	std::cout << "texture size = " << w << "," << h << std::endl;
-	state.size.x = static_cast<float>(w);
-	state.size.y = static_cast<float>(h);
-	state.speed.x = 0;
-	state.speed.y = 0;
+	std::cout << file << " size = " << width << "," << height << std::endl;
+	return tex;
+}
+
+EntityTextures::EntityTextures(SDL_Renderer *renderer) {
+	this->renderer = renderer;
+	this->paddle = loadEntityTexture("paddle.png", renderer, this->paddleWidth, this->paddleHeight);
+	this->ball = loadEntityTexture("ball.png", renderer, this->ballWidth, this->ballHeight);
+}
+
+EntityTextures::~EntityTextures() {
+	SDL_DestroyTexture(this->paddle);
+	SDL_DestroyTexture(this->ball);
+}
+
+void EntityTextures::reload() {
+	SDL_DestroyTexture(this->paddle);
+	SDL_DestroyTexture(this->ball);
+	this->paddle = loadEntityTexture("paddle.png", this->renderer, this->paddleWidth, this->paddleHeight);
+	this->ball = loadEntityTexture("ball.png", this->renderer, this->ballWidth, this->ballHeight);
+}
+
+Player::Player(const EntityTextures *textures) {
+	this->textures = textures;
+	this->sprite = nullptr;
 	this->score = 0;
 }
 
-Player::~Player() {
-	SDL_DestroyTexture(tex);
+void Player::render(MovingRect &state, const FieldTransform &transform) {
+	SDL_Rect rect = transform.apply(state);
+	renderTexture(this->textures->paddle, this->textures->renderer, rect.x, rect.y, rect.w, rect.h);
 }
 
-void Player::render(MovingRect &state) {
-	renderTexture(this->tex, this->renderer, state.pos.x, state.pos.y);
+void Player::render(MovingRect &state, const FieldTransform &transform, Compositor &compositor) {
+	SDL_Rect rect = transform.apply(state);
+	this->sprite = spriteForSize(this->sprite, compositor, "paddle.png", transform, state);
+	compositor.drawSprite(this->sprite, rect.x, rect.y);
 }
 
-Ball::Ball(SDL_Renderer *renderer, MovingRect &state) {
-	this->renderer = renderer;
-	this->tex = loadTexture("ball.png", renderer);
-	if (this->tex == nullptr) {
-		logFatal("loadTexture");
-	}
-	int w, h;
-	if (SDL_QueryTexture(this->tex, nullptr, nullptr, &w, &h) != 0) {
-		logFatal("QueryTexture");
-	}
-	state.size.x = static_cast<float>(w);
-	state.size.y = static_cast<float>(h);
+Ball::Ball(const EntityTextures *textures) {
+	this->textures = textures;
+	this->sprite = nullptr;
 }
 
-Ball::~Ball() {
-	SDL_DestroyTexture(this->tex);
+void Ball::render(MovingRect &ball, const FieldTransform &transform) {
+	SDL_Rect rect = transform.apply(ball);
+	renderTexture(this->textures->ball, this->textures->renderer, rect.x, rect.y, rect.w, rect.h);
 }
 
-void Ball::render(MovingRect &ball) {
-	renderTexture(this->tex, renderer, ball.pos.x, ball.pos.y);
-}
\ No newline at end of file
+void Ball::render(MovingRect &ball, const FieldTransform &transform, Compositor &compositor) {
+	SDL_Rect rect = transform.apply(ball);
+	this->sprite = spriteForSize(this->sprite, compositor, "ball.png", transform, ball);
+	compositor.drawSprite(this->sprite, rect.x, rect.y);
+}
@@ -4,6 +4,7 @@
 #include <SDL.h>
 
 #include "util.h"
+#include "compositor.h"
 
 class Vector2 {
 public:
@@ -22,37 +23,80 @@ public:
 
 	MovingRect();
 
-	Vector2 getCenter();
+	Vector2 getCenter() const;
 
 	static MovingRect lerpBetween(const MovingRect &start, const MovingRect &finish, float progress);
 };
 
+/* Maps positions and sizes on the playing field to pixels in some viewport */
+class FieldTransform {
+public:
+	float scaleX;
+	float scaleY;
+	int offsetX;
+	int offsetY;
+
+	FieldTransform(); // field units are pixels
+	/* fits a field of the given size to exactly fill viewport */
+	FieldTransform(int fieldWidth, int fieldHeight, const SDL_Rect &viewport);
+
+	SDL_Rect apply(const MovingRect &rect) const;
+	/**
+	* The size in pixels of something size field units big. Unlike apply(), which rounds each edge and so
+	* can be a pixel bigger or smaller depending on where the thing is, this only depends on the transform.
+	*/
+	void applySize(const Vector2 &size, int &width, int &height) const;
+};
+
+/* The textures entities are drawn with; load them once and share them between every entity (and World) */
+class EntityTextures {
+public:
+	SDL_Renderer *renderer;
+	SDL_Texture *paddle;
+	int paddleWidth;
+	int paddleHeight;
+	SDL_Texture *ball;
+	int ballWidth;
+	int ballHeight;
+
+	explicit EntityTextures(SDL_Renderer *renderer);
+	~EntityTextures();
+
+	/* Loads the textures again, after SDL_RENDER_DEVICE_RESET has destroyed them */
+	void reload();
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(EntityTextures);
+};
+
 class Player {
 public:
 	int score;
 
-	Player(SDL_Renderer *renderer, MovingRect &state);
-	~Player();
+	/* @param textures what to draw with, or nullptr if this player will never be drawn */
+	explicit Player(const EntityTextures *textures);
 
-	void render(MovingRect &state);
+	void render(MovingRect &state, const FieldTransform &transform);
+	void render(MovingRect &state, const FieldTransform &transform, Compositor &compositor);
 
 private:
 	DISALLOW_COPY_AND_ASSIGN(Player);
-	SDL_Renderer *renderer;
-	SDL_Texture *tex;
+	const EntityTextures *textures;
+	const Sprite *sprite; // loaded (at the right size) when we're drawn with a Compositor
 };
 
 class Ball {
 public:
-	Ball(SDL_Renderer *renderer, MovingRect &state);
-	~Ball();
+	/* @param textures what to draw with, or nullptr if this ball will never be drawn */
+	explicit Ball(const EntityTextures *textures);
 
-	void render(MovingRect &state);
+	void render(MovingRect &state, const FieldTransform &transform);
+	void render(MovingRect &state, const FieldTransform &transform, Compositor &compositor);
 
 private:
 	DISALLOW_COPY_AND_ASSIGN(Ball);
-	SDL_Renderer *renderer;
-	SDL_Texture *tex;
+	const EntityTextures *textures;
+	const Sprite *sprite; // loaded (at the right size) when we're drawn with a Compositor
 };
 
 #endif
@@ -4,12 +4,22 @@
 #include "util.h"
 #include "hud.h"
 
+// font size at the original 480 pixel high screen
+const int FONT_SIZE = 24;
+const int FONT_SIZE_SCREEN_HEIGHT = 480;
+
 Hud::Hud(SDL_Renderer *renderer, int screenWidth, int screenHeight) {
 	this->renderer = renderer;
+	this->width = screenWidth;
+	this->height = screenHeight;
 	SDL_Color defaultColor = {255, 255, 255};
 	this->color = color;
 
-	this->font = TTF_OpenFont("Vera.ttf", 24);
+	int fontSize = FONT_SIZE * screenHeight / FONT_SIZE_SCREEN_HEIGHT;
+	if (fontSize < 1) {
+		fontSize = 1;
+	}
+	this->font = TTF_OpenFont("Vera.ttf", fontSize);
 	if (this->font == nullptr) {
 		logSDLError("TTF_OpenFont");
 	}
@@ -21,15 +31,8 @@ Hud::Hud(SDL_Renderer *renderer, int screenWidth, int screenHeight) {
 	}
 
 	this->slowSurfaceDirty = false;
-
-	this->slowTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-		SDL_TEXTUREACCESS_STREAMING, screenWidth, screenHeight);
-	if (this->slowTexture == nullptr) {
-		logSDLError("SDL_CreateTexture");
-	}
-	if (SDL_SetTextureBlendMode(this->slowTexture, SDL_BLENDMODE_BLEND) != 0) {
-		logSDLError("SDL_SetTextureBlendMode");
-	}
+	SDL_Rect noBounds = { 0, 0, 0, 0 };
+	this->slowBounds = noBounds;
 
 	this->fastSurface = SDL_CreateRGBSurface(0, screenWidth, screenHeight, 32,
 		0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
@@ -38,9 +41,23 @@ Hud::Hud(SDL_Renderer *renderer, int screenWidth, int screenHeight) {
 	}
 
 	this->fastSurfaceDirty = false;
+	this->fastBounds = noBounds;
+
+	createTextures();
+}
 
-	this->fastTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-		SDL_TEXTUREACCESS_STREAMING, screenWidth, screenHeight);
+void Hud::createTextures() {
+	this->slowTexture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STREAMING, this->width, this->height);
+	if (this->slowTexture == nullptr) {
+		logSDLError("SDL_CreateTexture");
+	}
+	if (SDL_SetTextureBlendMode(this->slowTexture, SDL_BLENDMODE_BLEND) != 0) {
+		logSDLError("SDL_SetTextureBlendMode");
+	}
+
+	this->fastTexture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STREAMING, this->width, this->height);
 	if (this->fastTexture == nullptr) {
 		logSDLError("SDL_CreateTexture");
 	}
@@ -49,11 +66,46 @@ Hud::Hud(SDL_Renderer *renderer, int screenWidth, int screenHeight) {
 	}
 }
 
+void Hud::recreateTextures() {
+	SDL_DestroyTexture(this->slowTexture);
+	SDL_DestroyTexture(this->fastTexture);
+	createTextures();
+	// the surfaces still have the text on, it just needs uploading again
+	this->slowSurfaceDirty = true;
+	this->fastSurfaceDirty = true;
+}
+
+int Hud::getWidth() const {
+	return this->width;
+}
+
+int Hud::getHeight() const {
+	return this->height;
+}
+
 void Hud::setTextColor(uint8_t r, uint8_t g, uint8_t b) {
 	SDL_Color newColor = {r, g, b};
 	this->color = newColor;
 }
 
+// erases the text drawn to surface since it was last cleared, rather than the whole surface
+void clearSurface(SDL_Surface *surface, SDL_Rect &bounds) {
+	if (bounds.w > 0 && bounds.h > 0) {
+		SDL_FillRect(surface, &bounds, 0);
+	}
+	bounds.w = 0;
+	bounds.h = 0;
+}
+
+// grows bounds to include the blitted text at position (as clipped by SDL_BlitSurface)
+void growBounds(SDL_Rect &bounds, const SDL_Rect &position) {
+	if (bounds.w <= 0 || bounds.h <= 0) {
+		bounds = position;
+	} else {
+		SDL_UnionRect(&bounds, &position, &bounds);
+	}
+}
+
 // returns a rect with x and y components based on provided x and y but adjusted for the given
 // alignments using the width and height of the provided surface
 SDL_Rect calculatePosition(SDL_Surface *surface, int x, int y, AlignH alignH, AlignV alignV) {
@@ -86,13 +138,14 @@ void Hud::drawTextFast(int x, int y, const char *text, AlignH alignH, AlignV ali
 	}
 
 	if (!this->fastSurfaceDirty) {
-		SDL_FillRect(this->fastSurface, nullptr, 0);
+		clearSurface(this->fastSurface, this->fastBounds);
 	}
 	
 	SDL_Rect position = calculatePosition(textSurface, x, y, alignH, alignV);
 	if (SDL_BlitSurface(textSurface, nullptr, this->fastSurface, &position) != 0) {
 		logSDLError("BlitSurface");
 	}
+	growBounds(this->fastBounds, position);
 	SDL_FreeSurface(textSurface);
 
 	this->fastSurfaceDirty = true;
@@ -116,19 +169,21 @@ void Hud::drawTextBlended(int x, int y, const char *text, AlignH alignH, AlignV
 		logSDLError("SetSurfaceBlendMode");
 	}
 
-	if (!this->slowSurfaceDirty) {
-		SDL_FillRect(this->slowSurface, nullptr, 0);
-	}
-
 	SDL_Rect position = calculatePosition(textSurface, x, y, alignH, alignV);
 	if (SDL_BlitSurface(textSurface, nullptr, this->slowSurface, &position) != 0) {
 		logSDLError("BlitSurface");
 	}
+	growBounds(this->slowBounds, position);
 	SDL_FreeSurface(textSurface);
 
 	this->slowSurfaceDirty = true;
 }
 
+void Hud::clearBlended() {
+	clearSurface(this->slowSurface, this->slowBounds);
+	this->slowSurfaceDirty = true;
+}
+
 void updateTextureFromSurface(SDL_Texture *texture, SDL_Surface *surface) {
 	bool requiresLocking = SDL_MUSTLOCK(surface) != 0;
 
@@ -160,6 +215,15 @@ void Hud::render() {
 	renderTexture(this->fastTexture, this->renderer, 0, 0);
 }
 
+void Hud::composite(Compositor &compositor) {
+	// the surfaces are read directly, so there's nothing to upload
+	this->slowSurfaceDirty = false;
+	this->fastSurfaceDirty = false;
+
+	compositor.blendSurface(this->slowSurface, this->slowBounds);
+	compositor.blendSurface(this->fastSurface, this->fastBounds);
+}
+
 Hud::~Hud() {
 	SDL_FreeSurface(this->fastSurface);
 	SDL_DestroyTexture(this->fastTexture);
@@ -1,6 +1,8 @@
 #ifndef HUD_H
 #define HUD_H
 
+#include "compositor.h"
+
 enum class AlignH {
 	Left,
 	Center,
@@ -15,9 +17,13 @@ enum class AlignV {
 
 class Hud {
 public:
+	/* The HUD covers a screenWidth x screenHeight render target; text is scaled with its height */
 	Hud(SDL_Renderer *renderer, int screenWidth, int screenHeight);
 	~Hud();
 
+	int getWidth() const;
+	int getHeight() const;
+
 	void setTextColor(uint8_t r, uint8_t g, uint8_t b);
 	void drawTextFast(int x, int y, const char *text);
 	void drawTextFast(int x, int y, const char *text, AlignH alignH);
@@ -25,19 +31,31 @@ public:
 	void drawTextBlended(int x, int y, const char *text);
 	void drawTextBlended(int x, int y, const char *text, AlignH alignH);
 	void drawTextBlended(int x, int y, const char *text, AlignH alignH, AlignV alignV);
+	/* Erases everything drawn with drawTextBlended; call it before drawing the blended text again */
+	void clearBlended();
 
 	void render();
+	/* Makes the textures again, after SDL_RENDER_DEVICE_RESET has destroyed them */
+	void recreateTextures();
+	/* Draws the HUD with a Compositor instead of the renderer; only the parts with text in are blended */
+	void composite(Compositor &compositor);
 
 private:
 	SDL_Renderer *renderer;
+	int width;
+	int height;
 	SDL_Color color;
 	TTF_Font *font;
 	SDL_Surface *slowSurface;
 	bool slowSurfaceDirty;
+	SDL_Rect slowBounds; // the area of slowSurface which has text in
 	SDL_Texture *slowTexture;
 	SDL_Surface *fastSurface;
 	bool fastSurfaceDirty;
+	SDL_Rect fastBounds;
 	SDL_Texture *fastTexture;
+
+	void createTextures();
 };
 
 #endif
\ No newline at end of file
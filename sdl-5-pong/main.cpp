@@ -2,142 +2,892 @@
 #include <string>
 #include <iostream>
 #include <time.h>
+#include <cstring>
+#include <cstdlib>
 #include <exception>
+#include <vector>
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
+#include <SDL_net.h>
 
 #include "util.h"
 #include "entities.h"
 #include "hud.h"
 #include "world.h"
+#include "audio.h"
+#include "telemetry.h"
+#include "broadcast.h"
+#include "server.h"
+#include "compositor.h"
+#include "display.h"
+#include "controllers.h"
+#include "timestep.h"
+#include "wall.h"
 
-const int SCREEN_WIDTH  = 640;
-const int SCREEN_HEIGHT = 480;
+// the defaults for both the window and internal resolution
+const int SCREEN_WIDTH  = FIELD_WIDTH;
+const int SCREEN_HEIGHT = FIELD_HEIGHT;
 
+// how long to block waiting for events while there's nothing to simulate or draw
+const int IDLE_WAIT_MS = 100;
+
+// how long the scripted controller moves in each direction
+const Uint32 SCRIPTED_PERIOD_TICKS = 150;
+
+// room for ten minutes of --record before it has to grow
+const size_t RECORDING_RESERVE_TICKS = static_cast<size_t>(600 / PHYSICS_TIMESTEP);
+
+// how long to spend simulating each frame before slowing the game down instead
+const float DEFAULT_SUBSTEP_BUDGET_MS = 8.0f;
+
+const int AUDIO_FREQUENCY = 44100;
+const int DEFAULT_AUDIO_BUFFER_SAMPLES = 512; // ~12ms at 44.1kHz
+
+struct Options {
+	int audioBufferSamples;
+	bool publishTelemetry;
+	bool broadcast;
+	const char *relayHost; // where --broadcast sends the game
+	bool relay;
+	const char *spectateHost; // nullptr unless spectating
+	bool server;
+	const char *loadgenHost; // nullptr unless generating load
+	int matches;
+	int workers;
+	Uint32 durationMs;
+	Uint16 port; // 0 for the default for whatever we're doing
+	bool softwareRenderer;
+	bool cpuBlit;
+	int windowWidth;
+	int windowHeight;
+	int renderWidth;
+	int renderHeight;
+	bool fullscreen;
+	const char *humanControl; // nullptr for the default: keyboard in the game, network input on the server
+	const char *replayFile; // what --human-control replay plays back
+	const char *recordFile; // nullptr unless recording the game for replaying later
+	float substepBudgetMs;
+	float timeScale;
+	int wallMatches; // 0 unless showing a wall of matches
+};
+
+// parses something like "1280x720", returning false if it doesn't look like that
+bool parseSize(const char *text, int &width, int &height) {
+	int w = 0;
+	int h = 0;
+	char separator = 0;
+	std::istringstream ss(text);
+	if (!(ss >> w >> separator >> h) || separator != 'x' || w <= 0 || h <= 0) {
+		return false;
+	}
+	width = w;
+	height = h;
+	return true;
+}
+
+// the headless modes don't need video, audio, images or fonts
+int runHeadless(const Options &options) {
+	if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0) {
+		logSDLError("SDL_Init");
+	}
+	if (SDLNet_Init() == -1) {
+		logSDLError("SDLNet_Init");
+	}
+
+	const Uint16 port = options.port != 0 ? options.port : options.relay ? BROADCAST_DEFAULT_PORT : SERVER_DEFAULT_PORT;
+	int exitCode = 0;
+	if (options.relay) {
+		SpectatorRelay *relay = new SpectatorRelay(port);
+		relay->run(options.durationMs);
+		delete relay;
+	} else if (options.server) {
+		const bool aiVsAi = options.humanControl != nullptr && std::strcmp(options.humanControl, "ai") == 0;
+		MatchServer *server = new MatchServer(options.matches, options.workers, port, aiVsAi);
+		server->run(options.durationMs);
+		delete server;
+	} else {
+		exitCode = runLoadGenerator(options.loadgenHost, port, options.matches, options.durationMs);
+	}
+
+	SDLNet_Quit();
+	SDL_Quit();
+	return exitCode;
+}
+
+// redraws all the blended text, so anything else drawn before (like "Paused") goes
 void drawUI(Hud *hud, WorldState &state) {
+	hud->clearBlended();
 	hud->setTextColor(255, 0, 0);
-	hud->drawTextBlended(SCREEN_WIDTH / 2, 0, "It's a Pong!", AlignH::Center);
+	hud->drawTextBlended(hud->getWidth() / 2, 0, "It's a Pong!", AlignH::Center);
 
 	hud->setTextColor(0, 0, 255);
-	hud->drawTextBlended(0, SCREEN_HEIGHT, std::to_string(state.humanScore).c_str(),
+	hud->drawTextBlended(0, hud->getHeight(), std::to_string(state.humanScore).c_str(),
 		AlignH::Left, AlignV::Bottom);
-	hud->drawTextBlended(SCREEN_WIDTH, SCREEN_HEIGHT, std::to_string(state.opponentScore).c_str(), AlignH::Right, AlignV::Bottom);
+	hud->drawTextBlended(hud->getWidth(), hud->getHeight(), std::to_string(state.opponentScore).c_str(), AlignH::Right, AlignV::Bottom);
 }
 
-void drawFps(Hud *hud, int fps) {
+// adds "Paused" to whatever blended text is already drawn
+void drawPausedText(Hud *hud) {
+	hud->setTextColor(255, 255, 255);
+	hud->drawTextBlended(hud->getWidth() / 2, hud->getHeight() / 2, "Paused", AlignH::Center, AlignV::Center);
+}
+
+void drawPaused(Hud *hud, WorldState &state) {
+	drawUI(hud, state);
+	drawPausedText(hud);
+}
+
+void drawFps(Hud *hud, int fps, float timeScale, bool overBudget) {
 	hud->setTextColor(255, 176, 0);
 	std::stringstream ss;
 	ss << "FPS: " << fps;
-	hud->drawTextFast(SCREEN_WIDTH, 0, ss.str().c_str(), AlignH::Right);
+	if (timeScale != 1.0f) {
+		ss << "  " << timeScale << "x";
+	}
+	if (overBudget) {
+		ss << " (slowed)";
+	}
+	hud->drawTextFast(hud->getWidth(), 0, ss.str().c_str(), AlignH::Right);
 }
 
-int main(int argc, char **argv) {
-	srand(static_cast<unsigned int>(time(nullptr))); //seed random number generator with the current time
+// draws a frame at the internal resolution with either the renderer or, if there is one, the compositor,
+// and scales it onto the window
+void renderFrame(Display *display, Compositor *compositor, World *world, Hud *hud, WorldState &state, bool drawWorld) {
+	if (compositor != nullptr) {
+		compositor->beginFrame();
+		if (drawWorld) {
+			world->render(state, *compositor);
+		}
+		hud->composite(*compositor);
+		display->clearOutput();
+		compositor->present(display->getOutputRect());
+		return;
+	}
 
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-		logSDLError("SDL_Init");
+	display->beginFrame();
+	if (drawWorld) {
+		world->render(state);
 	}
+	hud->render();
+	display->finishFrame();
+}
 
-	if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) != IMG_INIT_PNG) {
-		logSDLError("IMG_Init");
+// returns the controller for the human paddle named on the command line, or nullptr for the keyboard
+// what the game started from and what the human paddle did, which is all it takes to replay a game as the
+// simulation is deterministic. On disk it's the random state (little endian) then one byte per tick
+struct Recording {
+	Uint32 randomState;
+	std::vector<Sint8> inputs; // -1 up, 1 down, 0 still, from tick 1 onwards
+};
+
+bool loadRecording(const char *path, Recording &recording) {
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+	if (file == nullptr) {
+		std::cout << "Could not open " << path << ": " << SDL_GetError() << std::endl;
+		return false;
+	}
+	const Sint64 size = SDL_RWsize(file);
+	bool loaded = size >= 4;
+	if (loaded) {
+		recording.randomState = SDL_ReadLE32(file);
+		recording.inputs.resize(static_cast<size_t>(size - 4));
+		loaded = recording.inputs.empty()
+			|| SDL_RWread(file, &recording.inputs[0], 1, recording.inputs.size()) == recording.inputs.size();
+	}
+	SDL_RWclose(file);
+	if (!loaded) {
+		std::cout << path << " isn't a recording" << std::endl;
 	}
+	return loaded;
+}
 
-	if (TTF_Init() == -1) {
-		logSDLError("TTF_Init");
+void saveRecording(const char *path, const Recording &recording) {
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+	if (file == nullptr) {
+		std::cout << "Could not save the recording to " << path << ": " << SDL_GetError() << std::endl;
+		return;
 	}
+	SDL_WriteLE32(file, recording.randomState);
+	if (!recording.inputs.empty()) {
+		SDL_RWwrite(file, &recording.inputs[0], 1, recording.inputs.size());
+	}
+	SDL_RWclose(file);
+	std::cout << "Recorded " << recording.inputs.size() << " ticks to " << path << std::endl;
+}
 
-	SDL_Window *window = SDL_CreateWindow("Pong", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-			SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-	if (window == nullptr) {
-		logSDLError("CreateWindow");
+// @param replay what to play back with "replay", or nullptr if it couldn't be loaded
+Controller *createHumanController(const char *name, const Recording *replay) {
+	if (name == nullptr || std::strcmp(name, "keyboard") == 0) {
+		return nullptr;
+	} else if (std::strcmp(name, "ai") == 0) {
+		return new PolicyController<ChaseAiController>();
+	} else if (std::strcmp(name, "scripted") == 0) {
+		return new PolicyController<ScriptedController>(ScriptedController(SCRIPTED_PERIOD_TICKS));
+	} else if (std::strcmp(name, "replay") == 0) {
+		if (replay == nullptr) {
+			std::cout << "Nothing to replay, using the keyboard" << std::endl;
+			return nullptr;
+		}
+		const Sint8 *inputs = replay->inputs.empty() ? nullptr : &replay->inputs[0];
+		return new PolicyController<ReplayController>(
+			ReplayController(inputs, static_cast<Uint32>(replay->inputs.size()), 1));
 	}
-	//SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-	SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-	if (renderer == nullptr) {
-		logSDLError("CreateRenderer");
+	std::cout << "Unknown --human-control " << name << ", using the keyboard" << std::endl;
+	return nullptr;
+}
+
+// creates a world to be drawn at the display's internal resolution
+World *createWorld(Display *display, const EntityTextures *textures, WorldState &state) {
+	World *world = new World(textures, FIELD_WIDTH, FIELD_HEIGHT, state);
+	// the biggest field that fits without stretching, centred with black bars either side
+	const int width = display->getInternalWidth();
+	const int height = display->getInternalHeight();
+	int fieldWidth = width;
+	int fieldHeight = fieldWidth * FIELD_HEIGHT / FIELD_WIDTH;
+	if (fieldHeight > height) {
+		fieldHeight = height;
+		fieldWidth = fieldHeight * FIELD_WIDTH / FIELD_HEIGHT;
 	}
+	const SDL_Rect viewport = { (width - fieldWidth) / 2, (height - fieldHeight) / 2, fieldWidth, fieldHeight };
+	world->setRenderTransform(FieldTransform(FIELD_WIDTH, FIELD_HEIGHT, viewport));
+	return world;
+}
+
+// what the player and the window manager want the game loop to be doing
+struct RunState {
+	bool quit;
+	bool paused; // by the player
+	bool hidden; // minimised or hidden, so nobody can see what we draw
+	bool unfocused; // the player is doing something else, so can't be playing
+	bool redraw; // the window needs drawing again even if nothing has changed
+	bool texturesLost; // the renderer was reset and every texture needs making again
+	float timeScale; // how fast the player wants the game to run
+
+	RunState();
+	// true when there's no point simulating
+	bool isIdle() const;
+};
 
+RunState::RunState() {
+	this->quit = false;
+	this->paused = false;
+	this->hidden = false;
+	this->unfocused = false;
+	this->redraw = false;
+	this->texturesLost = false;
+	this->timeScale = 1.0f;
+}
+
+bool RunState::isIdle() const {
+	return this->paused || this->hidden || this->unfocused;
+}
+
+void handleEvent(Display *display, const SDL_Event &event, RunState &run) {
+	switch(event.type) {
+	case SDL_QUIT:
+		run.quit = true;
+		break;
+	case SDL_KEYDOWN:
+		switch(event.key.keysym.scancode) {
+		case SDL_SCANCODE_ESCAPE:
+			run.quit = true;
+			break;
+		case SDL_SCANCODE_MINUS:
+			run.timeScale = run.timeScale / 2 < TIMESTEP_MIN_SCALE ? TIMESTEP_MIN_SCALE : run.timeScale / 2;
+			break;
+		case SDL_SCANCODE_EQUALS:
+			run.timeScale = run.timeScale * 2 > TIMESTEP_MAX_SCALE ? TIMESTEP_MAX_SCALE : run.timeScale * 2;
+			break;
+		case SDL_SCANCODE_BACKSPACE:
+			run.timeScale = 1.0f;
+			break;
+		case SDL_SCANCODE_P:
+		case SDL_SCANCODE_PAUSE:
+			run.paused = !run.paused;
+			break;
+		case SDL_SCANCODE_F11:
+			display->toggleFullscreen();
+			break;
+		case SDL_SCANCODE_RETURN:
+			if ((event.key.keysym.mod & KMOD_ALT) != 0) {
+				display->toggleFullscreen();
+			}
+			break;
+		}
+		break;
+	case SDL_WINDOWEVENT:
+		switch(event.window.event) {
+		case SDL_WINDOWEVENT_MINIMIZED:
+		case SDL_WINDOWEVENT_HIDDEN:
+			run.hidden = true;
+			break;
+		case SDL_WINDOWEVENT_RESTORED:
+		case SDL_WINDOWEVENT_MAXIMIZED:
+		case SDL_WINDOWEVENT_SHOWN:
+			run.hidden = false;
+			run.redraw = true;
+			break;
+		case SDL_WINDOWEVENT_FOCUS_LOST:
+			run.unfocused = true;
+			break;
+		case SDL_WINDOWEVENT_FOCUS_GAINED:
+			run.unfocused = false;
+			break;
+		case SDL_WINDOWEVENT_EXPOSED:
+		case SDL_WINDOWEVENT_SIZE_CHANGED:
+			run.redraw = true;
+			break;
+		}
+		break;
+#if SDL_VERSION_ATLEAST(2, 0, 2)
+	case SDL_RENDER_TARGETS_RESET:
+		// the target's contents are gone, but we draw all of it every frame anyway
+		run.redraw = true;
+		break;
+#endif
+#if SDL_VERSION_ATLEAST(2, 0, 4)
+	case SDL_RENDER_DEVICE_RESET:
+		display->recreateTarget();
+		run.texturesLost = true;
+		run.redraw = true;
+		break;
+#endif
+	}
+}
+
+// makes every texture again after the renderer has been reset; any of them can be nullptr
+void recreateTextures(RunState &run, EntityTextures *textures, Hud *hud, Compositor *compositor) {
+	std::cout << "Renderer was reset; recreating textures" << std::endl;
+	if (textures != nullptr) {
+		textures->reload();
+	}
+	if (hud != nullptr) {
+		hud->recreateTextures();
+	}
+	if (compositor != nullptr) {
+		compositor->recreateTexture();
+	}
+	run.texturesLost = false;
+}
+
+/**
+* Handles all pending events.
+* @param waitMs if there aren't any, block for up to this long waiting for one (instead of spinning)
+*/
+void handleEvents(Display *display, RunState &run, int waitMs) {
+	SDL_Event event;
+	//TODO figure out where user input handling should go. @see http://gamedev.stackexchange.com/questions/8623/a-good-way-to-build-a-game-loop-in-opengl
+	if (waitMs > 0) {
+		if (!SDL_WaitEventTimeout(&event, waitMs)) {
+			return;
+		}
+		handleEvent(display, event, run);
+	}
+	while (SDL_PollEvent(&event)) {
+		handleEvent(display, event, run);
+	}
+}
+
+void runGame(Display *display, const Options &options) {
+	SDL_Renderer *renderer = display->getRenderer();
+	const int renderWidth = display->getInternalWidth();
+	const int renderHeight = display->getInternalHeight();
 	FpsTracker fpsTracker(100);
 
 	WorldState currentWorldState;
-	World *world = new World(renderer, SCREEN_WIDTH, SCREEN_HEIGHT, currentWorldState);
+	EntityTextures *textures = new EntityTextures(renderer);
+	World *world = createWorld(display, textures, currentWorldState);
+	Recording replay;
+	const bool replaying = options.replayFile != nullptr && loadRecording(options.replayFile, replay);
+	if (replaying) {
+		currentWorldState.randomState = replay.randomState; // so the ball is served the same way
+	}
+	Recording *recording = options.recordFile != nullptr ? new Recording() : nullptr;
+	if (recording != nullptr) {
+		recording->randomState = currentWorldState.randomState;
+		recording->inputs.reserve(RECORDING_RESERVE_TICKS);
+	}
+	Controller *humanController = createHumanController(options.humanControl, replaying ? &replay : nullptr);
+	world->setControllers(humanController, nullptr);
 	world->startRound(currentWorldState);
+
+	Mixer *mixer = new Mixer(AUDIO_FREQUENCY, options.audioBufferSamples);
+	world->setListener(mixer);
 	WorldState previousWorldState=currentWorldState;
 
-	Hud *hud = new Hud(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+	Hud *hud = new Hud(renderer, renderWidth, renderHeight);
 	drawUI(hud, currentWorldState);
 
-	float dt = PHYSICS_TIMESTEP;
+	TelemetryPublisher *telemetry = options.publishTelemetry ? new TelemetryPublisher() : nullptr;
+	TelemetrySample telemetrySample;
+	std::memset(&telemetrySample, 0, sizeof(telemetrySample));
+	const float microsecondsPerCount = 1000000.0f / SDL_GetPerformanceFrequency();
+
+	SpectatorFeed *feed = options.broadcast ? new SpectatorFeed(options.relayHost, options.port) : nullptr;
+	Compositor *compositor = options.cpuBlit ? new Compositor(renderer, renderWidth, renderHeight) : nullptr;
+
+	const float dt = PHYSICS_TIMESTEP;
+	FixedTimestep timestep(dt, options.substepBudgetMs / 1000.0f);
 
 	Uint64 currentTime = SDL_GetPerformanceCounter();
-	float accumulator = 0;
 
-	bool quit = false;
-	SDL_Event event;
-	while (!quit) {
+	RunState run;
+	run.timeScale = options.timeScale;
+	bool wasIdle = false;
+	while (!run.quit) {
+		if (run.texturesLost) {
+			recreateTextures(run, textures, hud, compositor);
+		}
+		if (run.isIdle()) {
+			// nothing is simulated while idle, so the only thing worth drawing is the paused frame, and
+			// that only when the window needs it
+			if (!wasIdle) {
+				mixer->setPaused(true);
+				drawPaused(hud, currentWorldState);
+				run.redraw = true;
+				wasIdle = true;
+			}
+			if (run.redraw && !run.hidden) {
+				WorldState lerped = WorldState::lerpBetween(previousWorldState, currentWorldState, timestep.getAlpha());
+				renderFrame(display, compositor, world, hud, lerped, true);
+				SDL_RenderPresent(renderer);
+			}
+			run.redraw = false;
+			handleEvents(display, run, IDLE_WAIT_MS);
+			continue;
+		}
+		if (wasIdle) {
+			// carry on from where we paused, rather than trying to catch up on the time spent idle
+			currentTime = SDL_GetPerformanceCounter();
+			mixer->setPaused(false);
+			drawUI(hud, currentWorldState);
+			wasIdle = false;
+		}
+
 		const Uint64 newTime = SDL_GetPerformanceCounter();
 		float deltaTime = static_cast<float>(newTime - currentTime) / SDL_GetPerformanceFrequency(); //aka time for this frame
 		currentTime = newTime;
 
+		telemetrySample.frameTime = deltaTime * 1000000.0f;
+
 		if (deltaTime > 0.25f) {
 			std::cout << "limiting delta time to 0.25f" << std::endl;
 			deltaTime = 0.25f; // anti "spiral of death" / breakpoints
+			++telemetrySample.clampedFrames;
 		}
 
-		accumulator += deltaTime;
-
-		int simCount = 0;
-		while (accumulator >= dt) {
-			accumulator -= dt;
+		timestep.setTimeScale(run.timeScale);
+		run.timeScale = timestep.getTimeScale(); // as clamped
+		const bool wasOverBudget = timestep.isOverBudget();
+		const float droppedBefore = timestep.getDroppedTime();
+		const int simCount = timestep.advance(deltaTime);
+		// only time the steps themselves, so the budget isn't spent on anything else
+		const Uint64 simulateStart = SDL_GetPerformanceCounter();
+		bool scoreChanged = false;
+		for (int i = 0; i < simCount; ++i) {
 			previousWorldState = currentWorldState;
 			world->update(currentWorldState, dt); //aka integrate
+			if (recording != nullptr) {
+				const float speed = currentWorldState.human.speed.y;
+				recording->inputs.push_back(static_cast<Sint8>(speed < 0 ? -1 : speed > 0 ? 1 : 0));
+			}
 			if (currentWorldState.humanScore != previousWorldState.humanScore
 				|| currentWorldState.opponentScore != previousWorldState.opponentScore) {
-					drawUI(hud, currentWorldState);
+					scoreChanged = true; // redrawn once, after all the steps
 			}
-			++simCount;
 		}
+		timestep.measured(static_cast<float>(SDL_GetPerformanceCounter() - simulateStart) / SDL_GetPerformanceFrequency(), simCount);
 		if (simCount > 1) {
-			std::cout << "Simulated multiple steps:" << simCount << std::endl;
+			++telemetrySample.multiStepFrames;
+		}
+		if (timestep.isOverBudget()) {
+			if (!wasOverBudget) {
+				std::cout << "Simulation over budget; slowing the game down" << std::endl;
+			}
+			++telemetrySample.overBudgetFrames;
+		}
+		telemetrySample.droppedTime = (timestep.getDroppedTime() - droppedBefore) * 1000000.0f;
+		if (feed != nullptr && simCount > 0) {
+			feed->submit(currentWorldState, timestep.getTimeScale());
+		}
+		const Uint64 simulatedTime = SDL_GetPerformanceCounter();
+
+		if (scoreChanged) {
+			drawUI(hud, currentWorldState);
+		}
+		WorldState lerped = WorldState::lerpBetween(previousWorldState, currentWorldState, timestep.getAlpha());
+
+		drawFps(hud, static_cast<int>(1 / fpsTracker.calculateAverageFrameTime(deltaTime)),
+			timestep.getTimeScale(), timestep.isOverBudget());
+
+		renderFrame(display, compositor, world, hud, lerped, true);
+		const Uint64 renderedTime = SDL_GetPerformanceCounter();
+		SDL_RenderPresent(renderer);
+		const Uint64 presentedTime = SDL_GetPerformanceCounter();
+
+		handleEvents(display, run, 0);
+
+		if (telemetry != nullptr) {
+			telemetrySample.tick = currentWorldState.tick;
+			telemetrySample.substeps = simCount;
+			telemetrySample.simulateTime = (simulatedTime - simulateStart) * microsecondsPerCount;
+			telemetrySample.renderTime = (renderedTime - simulatedTime) * microsecondsPerCount;
+			telemetrySample.presentTime = (presentedTime - renderedTime) * microsecondsPerCount;
+			telemetrySample.inputTime = (SDL_GetPerformanceCounter() - presentedTime) * microsecondsPerCount;
+			telemetrySample.ballSpeedX = currentWorldState.ball.speed.x;
+			telemetrySample.ballSpeedY = currentWorldState.ball.speed.y;
+			telemetrySample.humanScore = currentWorldState.humanScore;
+			telemetrySample.opponentScore = currentWorldState.opponentScore;
+			telemetrySample.timeScale = timestep.getTimeScale();
+			telemetry->publish(telemetrySample);
+		}
+	}
+
+	delete compositor;
+	delete feed;
+	delete hud;
+	delete world;
+	delete textures;
+	delete humanController;
+	delete mixer;
+	delete telemetry;
+	if (recording != nullptr) {
+		saveRecording(options.recordFile, *recording);
+		delete recording;
+	}
+}
+
+void runSpectator(Display *display, const Options &options) {
+	SDL_Renderer *renderer = display->getRenderer();
+	const int renderWidth = display->getInternalWidth();
+	const int renderHeight = display->getInternalHeight();
+	FpsTracker fpsTracker(100);
+
+	// the world is only used for drawing; the simulation happens in the broadcasting game
+	WorldState state;
+	EntityTextures *textures = new EntityTextures(renderer);
+	World *world = createWorld(display, textures, state);
+	world->startRound(state);
+
+	Hud *hud = new Hud(renderer, renderWidth, renderHeight);
+	drawUI(hud, state);
+
+	SpectatorClient *client = new SpectatorClient(options.spectateHost, options.port);
+	Compositor *compositor = options.cpuBlit ? new Compositor(renderer, renderWidth, renderHeight) : nullptr;
+
+	Uint64 currentTime = SDL_GetPerformanceCounter();
+	RunState run;
+	while (!run.quit) {
+		if (run.texturesLost) {
+			recreateTextures(run, textures, hud, compositor);
+		}
+		const Uint64 newTime = SDL_GetPerformanceCounter();
+		const float deltaTime = static_cast<float>(newTime - currentTime) / SDL_GetPerformanceFrequency();
+		currentTime = newTime;
+
+		client->poll();
+		const int humanScore = state.humanScore;
+		const int opponentScore = state.opponentScore;
+		client->interpolate(deltaTime, state);
+		if (state.humanScore != humanScore || state.opponentScore != opponentScore) {
+			drawUI(hud, state);
 		}
 
-		WorldState lerped = WorldState::lerpBetween(previousWorldState, currentWorldState, accumulator/dt);
+		// the game being watched carries on regardless, so keep up with it, but only draw it if it can be seen
+		if (run.hidden) {
+			handleEvents(display, run, IDLE_WAIT_MS);
+			continue;
+		}
 
-		drawFps(hud, static_cast<int>(1 / fpsTracker.calculateAverageFrameTime(deltaTime)));
+		drawFps(hud, static_cast<int>(1 / fpsTracker.calculateAverageFrameTime(deltaTime)), 1.0f, false);
 
-		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-		SDL_RenderClear(renderer);
-		world->render(lerped);
-		hud->render();
+		renderFrame(display, compositor, world, hud, state, client->hasState());
 		SDL_RenderPresent(renderer);
 
-		//TODO figure out where user input handling should go. @see http://gamedev.stackexchange.com/questions/8623/a-good-way-to-build-a-game-loop-in-opengl
-		while (SDL_PollEvent(&event)) {
-			switch(event.type) {
-			case SDL_QUIT:
-				quit = true;
-				break;
-			case SDL_KEYDOWN:
-				switch(event.key.keysym.scancode) {
-				case SDL_SCANCODE_ESCAPE:
-					quit = true;
-					break;
+		handleEvents(display, run, 0);
+	}
+
+	delete compositor;
+	delete client;
+	delete hud;
+	delete world;
+	delete textures;
+}
+
+// draws the wall and the HUD into the compositor's frame
+void compositeWall(Compositor *compositor, MatchWall *wall, Hud *hud, float alpha) {
+	compositor->beginFrame();
+	wall->render(*compositor, alpha);
+	hud->composite(*compositor);
+}
+
+void runWall(Display *display, const Options &options) {
+	SDL_Renderer *renderer = display->getRenderer();
+	const int renderWidth = display->getInternalWidth();
+	const int renderHeight = display->getInternalHeight();
+	FpsTracker fpsTracker(100);
+
+	// everything is drawn with the compositor, so the whole wall goes to the renderer as one texture
+	Compositor *compositor = new Compositor(renderer, renderWidth, renderHeight);
+	EntityTextures *textures = new EntityTextures(renderer);
+	MatchWall *wall = new MatchWall(textures, options.wallMatches, renderWidth, renderHeight);
+	Hud *hud = new Hud(renderer, renderWidth, renderHeight);
+
+	const float dt = PHYSICS_TIMESTEP;
+	FixedTimestep timestep(dt, options.substepBudgetMs / 1000.0f);
+
+	// what each frame costs, so you can see how many matches a machine can keep up with
+	Uint64 frames = 0;
+	Uint64 simulateCounts = 0;
+	Uint64 compositeCounts = 0;
+	Uint64 presentCounts = 0;
+
+	Uint64 currentTime = SDL_GetPerformanceCounter();
+	RunState run;
+	run.timeScale = options.timeScale;
+	bool wasIdle = false;
+	while (!run.quit) {
+		if (run.texturesLost) {
+			recreateTextures(run, textures, hud, compositor);
+		}
+		if (run.isIdle()) {
+			// as in runGame, only draw the paused frame when the window needs it
+			if (!wasIdle) {
+				hud->clearBlended(); // the wall has no other blended text
+				drawPausedText(hud);
+				run.redraw = true;
+				wasIdle = true;
+			}
+			if (run.redraw && !run.hidden) {
+				compositeWall(compositor, wall, hud, timestep.getAlpha());
+				display->clearOutput();
+				compositor->present(display->getOutputRect());
+				SDL_RenderPresent(renderer);
+			}
+			run.redraw = false;
+			handleEvents(display, run, IDLE_WAIT_MS);
+			currentTime = SDL_GetPerformanceCounter();
+			continue;
+		}
+		if (wasIdle) {
+			hud->clearBlended();
+			wasIdle = false;
+		}
+
+		const Uint64 newTime = SDL_GetPerformanceCounter();
+		float deltaTime = static_cast<float>(newTime - currentTime) / SDL_GetPerformanceFrequency();
+		currentTime = newTime;
+		if (deltaTime > 0.25f) {
+			deltaTime = 0.25f;
+		}
+
+		timestep.setTimeScale(run.timeScale);
+		run.timeScale = timestep.getTimeScale();
+		const int simCount = timestep.advance(deltaTime);
+		const Uint64 simulateStart = SDL_GetPerformanceCounter();
+		for (int i = 0; i < simCount; ++i) {
+			wall->update(dt);
+		}
+		const Uint64 simulatedTime = SDL_GetPerformanceCounter();
+		timestep.measured(static_cast<float>(simulatedTime - simulateStart) / SDL_GetPerformanceFrequency(), simCount);
+
+		drawFps(hud, static_cast<int>(1 / fpsTracker.calculateAverageFrameTime(deltaTime)),
+			timestep.getTimeScale(), timestep.isOverBudget());
+
+		const Uint64 compositeStart = SDL_GetPerformanceCounter();
+		compositeWall(compositor, wall, hud, timestep.getAlpha());
+		const Uint64 compositedTime = SDL_GetPerformanceCounter();
+		display->clearOutput();
+		compositor->present(display->getOutputRect());
+		SDL_RenderPresent(renderer);
+
+		++frames;
+		simulateCounts += simulatedTime - simulateStart;
+		compositeCounts += compositedTime - compositeStart;
+		presentCounts += SDL_GetPerformanceCounter() - compositedTime;
+
+		handleEvents(display, run, 0);
+	}
+
+	std::cout << wall->getFinishedCount() << " matches finished" << std::endl;
+	if (frames > 0) {
+		const double msPerCount = 1000.0 / SDL_GetPerformanceFrequency() / frames;
+		std::cout << "Average per frame over " << frames << " frames: simulating " << simulateCounts * msPerCount
+			<< "ms, compositing " << compositeCounts * msPerCount << "ms, uploading and presenting "
+			<< presentCounts * msPerCount << "ms" << std::endl;
+	}
+	delete hud;
+	delete wall;
+	delete textures;
+	delete compositor;
+}
+
+int main(int argc, char **argv) {
+	srand(static_cast<unsigned int>(time(nullptr))); //seed random number generator with the current time
+
+	Options options;
+	options.audioBufferSamples = DEFAULT_AUDIO_BUFFER_SAMPLES;
+	options.publishTelemetry = false;
+	options.broadcast = false;
+	options.relayHost = "localhost";
+	options.relay = false;
+	options.spectateHost = nullptr;
+	options.server = false;
+	options.loadgenHost = nullptr;
+	options.matches = 1000;
+	options.workers = 0;
+	options.durationMs = 0;
+	options.port = 0;
+	options.softwareRenderer = false;
+	options.cpuBlit = false;
+	options.windowWidth = 0;
+	options.windowHeight = 0;
+	options.renderWidth = SCREEN_WIDTH;
+	options.renderHeight = SCREEN_HEIGHT;
+	options.fullscreen = false;
+	options.humanControl = nullptr;
+	options.replayFile = nullptr;
+	options.recordFile = nullptr;
+	options.substepBudgetMs = DEFAULT_SUBSTEP_BUDGET_MS;
+	options.timeScale = 1.0f;
+	options.wallMatches = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc) {
+			options.audioBufferSamples = std::atoi(argv[++i]);
+			if (options.audioBufferSamples < 1 || options.audioBufferSamples > MIXER_MAX_BUFFER_SAMPLES) {
+				std::cout << "--audio-buffer needs between 1 and " << MIXER_MAX_BUFFER_SAMPLES << " samples" << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[i], "--telemetry") == 0) {
+			options.publishTelemetry = true;
+		} else if (std::strcmp(argv[i], "--telemetry-monitor") == 0) {
+			return runTelemetryMonitor();
+		} else if (std::strcmp(argv[i], "--broadcast") == 0) {
+			options.broadcast = true;
+		} else if (std::strcmp(argv[i], "--relay-host") == 0 && i + 1 < argc) {
+			options.relayHost = argv[++i];
+		} else if (std::strcmp(argv[i], "--relay") == 0) {
+			options.relay = true;
+		} else if (std::strcmp(argv[i], "--spectate") == 0 && i + 1 < argc) {
+			options.spectateHost = argv[++i];
+		} else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+			options.port = static_cast<Uint16>(std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--server") == 0) {
+			options.server = true;
+		} else if (std::strcmp(argv[i], "--loadgen") == 0 && i + 1 < argc) {
+			options.loadgenHost = argv[++i];
+		} else if (std::strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+			options.matches = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			options.workers = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "--software") == 0) {
+			options.softwareRenderer = true;
+		} else if (std::strcmp(argv[i], "--cpu-blit") == 0) {
+			options.cpuBlit = true;
+		} else if (std::strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+			if (!parseSize(argv[++i], options.windowWidth, options.windowHeight)) {
+				std::cout << "Ignoring --window " << argv[i] << ", expected something like 1280x720" << std::endl;
+			}
+		} else if (std::strcmp(argv[i], "--render-size") == 0 && i + 1 < argc) {
+			if (!parseSize(argv[++i], options.renderWidth, options.renderHeight)) {
+				std::cout << "Ignoring --render-size " << argv[i] << ", expected something like 1280x720" << std::endl;
+			}
+		} else if (std::strcmp(argv[i], "--human-control") == 0 && i + 1 < argc) {
+			options.humanControl = argv[++i];
+			if (std::strcmp(options.humanControl, "replay") == 0) {
+				if (i + 1 >= argc) {
+					std::cout << "--human-control replay needs a recording to play back" << std::endl;
+					return 1;
 				}
-				break;
+				options.replayFile = argv[++i];
+			}
+		} else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			options.recordFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--substep-budget") == 0 && i + 1 < argc) {
+			options.substepBudgetMs = static_cast<float>(std::atof(argv[++i]));
+			if (!(options.substepBudgetMs > 0)) {
+				std::cout << "--substep-budget needs a number of milliseconds greater than 0" << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc) {
+			options.timeScale = static_cast<float>(std::atof(argv[++i]));
+			if (!(options.timeScale >= TIMESTEP_MIN_SCALE && options.timeScale <= TIMESTEP_MAX_SCALE)) {
+				std::cout << "--time-scale needs to be between " << TIMESTEP_MIN_SCALE << " and " << TIMESTEP_MAX_SCALE << std::endl;
+				return 1;
 			}
+		} else if (std::strcmp(argv[i], "--wall") == 0 && i + 1 < argc) {
+			options.wallMatches = std::atoi(argv[++i]);
+			if (options.wallMatches < 1 || options.wallMatches > WALL_MAX_MATCHES) {
+				std::cout << "--wall needs between 1 and " << WALL_MAX_MATCHES << " matches" << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[i], "--fullscreen") == 0) {
+			options.fullscreen = true;
+		} else if (std::strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+			options.durationMs = static_cast<Uint32>(std::atoi(argv[++i]) * 1000);
+		}
+	}
+	if (options.wallMatches > 0 && !MatchWall::hasRoomFor(options.wallMatches, options.renderWidth, options.renderHeight)) {
+		std::cout << "--render-size " << options.renderWidth << "x" << options.renderHeight << " is too small for a --wall of "
+			<< options.wallMatches << " matches" << std::endl;
+		return 1;
+	}
+	if (options.windowWidth == 0) {
+		// a window the size of what we render needs no scaling
+		options.windowWidth = options.renderWidth;
+		options.windowHeight = options.renderHeight;
+	}
+	if (options.workers <= 0) {
+		options.workers = SDL_GetCPUCount();
+	}
+
+	if (options.relay || options.server || options.loadgenHost != nullptr) {
+		return runHeadless(options);
+	}
+	if (options.port == 0) {
+		options.port = BROADCAST_DEFAULT_PORT;
+	}
+
+	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
+		logSDLError("SDL_Init");
+	}
+
+	if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) != IMG_INIT_PNG) {
+		logSDLError("IMG_Init");
+	}
+
+	if (TTF_Init() == -1) {
+		logSDLError("TTF_Init");
+	}
+
+	if (options.broadcast || options.spectateHost != nullptr) {
+		if (SDLNet_Init() == -1) {
+			logSDLError("SDLNet_Init");
 		}
 	}
 
+	Display *display = new Display("Pong", options.windowWidth, options.windowHeight,
+		options.renderWidth, options.renderHeight, options.fullscreen, options.softwareRenderer,
+		!options.cpuBlit && options.wallMatches == 0); // the wall is always composited
+
+	if (options.wallMatches > 0) {
+		runWall(display, options);
+	} else if (options.spectateHost != nullptr) {
+		runSpectator(display, options);
+	} else {
+		runGame(display, options);
+	}
+
 	std::cout << "Quitting" << std::endl;
 
 	//cleanup
-	delete hud;
-	delete world;
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+	delete display;
 
+	if (options.broadcast || options.spectateHost != nullptr) {
+		SDLNet_Quit();
+	}
 	TTF_Quit();
 	IMG_Quit();
 	SDL_Quit();
@@ -0,0 +1,83 @@
+#include <new>
+
+#include <SDL.h>
+
+#include "match_pool.h"
+#include "util.h"
+
+// start the matches on a cache line boundary, so the first one doesn't share a line with whatever's before it
+const size_t MATCH_ALIGNMENT = 64;
+
+Match::Match() : world(nullptr, FIELD_WIDTH, FIELD_HEIGHT, state), humanController(&input) {
+	this->dueTime = 0;
+	this->input = 0;
+	this->timer.data = this;
+	this->nextFree = nullptr;
+	this->world.setLogging(false);
+	this->world.startRound(this->state);
+}
+
+void Match::reset() {
+	this->input = 0;
+	this->world.reset(this->state);
+}
+
+bool Match::isFinished() const {
+	return this->state.humanScore >= MATCH_WINNING_SCORE || this->state.opponentScore >= MATCH_WINNING_SCORE;
+}
+
+MatchPool::MatchPool(int capacity) {
+	this->capacity = capacity;
+	this->activeCount = 0;
+
+	// one allocation for every match
+	this->storage = new Uint8[sizeof(Match) * capacity + MATCH_ALIGNMENT];
+	const size_t misalignment = reinterpret_cast<size_t>(this->storage) % MATCH_ALIGNMENT;
+	this->matches = reinterpret_cast<Match *>(this->storage + (misalignment == 0 ? 0 : MATCH_ALIGNMENT - misalignment));
+
+	// build the free list backwards so matches are handed out in order
+	this->firstFree = nullptr;
+	for (int i = capacity - 1; i >= 0; --i) {
+		Match *match = new (&this->matches[i]) Match();
+		match->nextFree = this->firstFree;
+		this->firstFree = match;
+	}
+}
+
+MatchPool::~MatchPool() {
+	for (int i = 0; i < this->capacity; ++i) {
+		this->matches[i].~Match();
+	}
+	delete[] this->storage;
+}
+
+Match *MatchPool::acquire() {
+	Match *match = this->firstFree;
+	if (match == nullptr) {
+		return nullptr;
+	}
+	this->firstFree = match->nextFree;
+	match->nextFree = nullptr;
+	match->reset();
+	++this->activeCount;
+	return match;
+}
+
+void MatchPool::release(Match *match) {
+	SDL_assert(match >= this->matches && match < this->matches + this->capacity);
+	match->nextFree = this->firstFree;
+	this->firstFree = match;
+	--this->activeCount;
+}
+
+Match &MatchPool::get(int index) {
+	return this->matches[index];
+}
+
+int MatchPool::getCapacity() const {
+	return this->capacity;
+}
+
+int MatchPool::getActiveCount() const {
+	return this->activeCount;
+}
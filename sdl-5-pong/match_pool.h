@@ -0,0 +1,68 @@
+#ifndef MATCH_POOL_H
+#define MATCH_POOL_H
+
+#include <atomic>
+
+#include <SDL.h>
+
+#include "util.h"
+#include "world.h"
+#include "controllers.h"
+#include "timer_wheel.h"
+
+#define MATCH_WINNING_SCORE 11 // a match is over once either side has this many points
+
+/* One headless match, e.g. stepped at a fixed cadence by a server worker */
+class Match {
+public:
+	TimerNode timer;
+	WorldState state;
+	World world;
+	Uint64 dueTime; // when the next tick should run, in microseconds
+	std::atomic<int> input; // latest direction received from the network
+	ExternalBufferController humanController; // follows input
+
+	Match();
+
+	/* Starts a new game in place: nothing is freed or allocated */
+	void reset();
+	bool isFinished() const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(Match);
+	friend class MatchPool;
+	Match *nextFree;
+};
+
+/**
+* A fixed number of matches in one contiguous allocation. Matches are constructed once, up front; after
+* that acquiring one just takes it off a free list and resets it, so matches can start and finish as
+* often as they like without any heap traffic. Not thread safe.
+*/
+class MatchPool {
+public:
+	explicit MatchPool(int capacity);
+	~MatchPool();
+
+	/**
+	* @return a freshly reset match, or nullptr if they're all in use. The most recently released match is
+	* the first to be handed out again, as it's the most likely to still be in cache.
+	*/
+	Match *acquire();
+	/* Returns a match acquired from this pool, for reuse */
+	void release(Match *match);
+
+	Match &get(int index);
+	int getCapacity() const;
+	int getActiveCount() const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(MatchPool);
+	Uint8 *storage; // raw memory the matches are constructed in
+	Match *matches;
+	Match *firstFree;
+	int capacity;
+	int activeCount;
+};
+
+#endif
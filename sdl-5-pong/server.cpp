@@ -0,0 +1,432 @@
+#include <iostream>
+#include <cstring>
+
+#include <SDL.h>
+#include <SDL_net.h>
+
+#include "server.h"
+#include "util.h"
+
+#ifdef __WIN32__
+#include <windows.h>
+#else
+#include <time.h>
+#ifdef __LINUX__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
+const Uint64 TIMESTEP_US = static_cast<Uint64>(PHYSICS_TIMESTEP * 1000000);
+
+// upper bounds (exclusive) of the lateness histogram buckets, in microseconds; the last bucket is open ended
+static const Uint64 LATENESS_BUCKET_LIMITS[SERVER_LATENESS_BUCKETS - 1] = { 50, 100, 250, 500, 1000, 2000, 5000 };
+
+static Uint64 nowMicroseconds() {
+	const Uint64 counter = SDL_GetPerformanceCounter();
+	const Uint64 frequency = SDL_GetPerformanceFrequency();
+	return (counter / frequency) * 1000000 + (counter % frequency) * 1000000 / frequency;
+}
+
+#ifdef __WIN32__
+const Uint64 SLEEP_SLACK_US = 2000; // Sleep() only wakes on the (at best 1ms) scheduler tick
+#else
+const Uint64 SLEEP_SLACK_US = 100; // nanosleep() usually wakes within a few tens of microseconds
+#endif
+
+// CPU time used by the calling thread so far, whether it was ticking matches, spinning or in the kernel
+static Uint64 threadCpuMicroseconds() {
+#ifdef __WIN32__
+	FILETIME created, exited, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) {
+		return 0;
+	}
+	const Uint64 kernel100ns = (static_cast<Uint64>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+	const Uint64 user100ns = (static_cast<Uint64>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+	return (kernel100ns + user100ns) / 10;
+#else
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+		return 0;
+	}
+	return static_cast<Uint64>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+#endif
+}
+
+// sleeps for most of the time until deadline, then spins for the last SLEEP_SLACK_US so we aren't woken late
+static void waitUntil(Uint64 deadline) {
+	const Uint64 now = nowMicroseconds();
+	if (deadline > now + SLEEP_SLACK_US) {
+		const Uint64 sleepUs = deadline - now - SLEEP_SLACK_US;
+#ifdef __WIN32__
+		SDL_Delay(static_cast<Uint32>(sleepUs / 1000));
+#else
+		timespec duration;
+		duration.tv_sec = static_cast<time_t>(sleepUs / 1000000);
+		duration.tv_nsec = static_cast<long>(sleepUs % 1000000) * 1000;
+		nanosleep(&duration, nullptr);
+#endif
+	}
+	while (nowMicroseconds() < deadline) {
+		// spin
+	}
+}
+
+static void pinCurrentThreadToCore(int core) {
+#ifdef __WIN32__
+	if (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) == 0) {
+		std::cerr << "Could not pin worker to core " << core << std::endl;
+	}
+#elif defined(__LINUX__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+		std::cerr << "Could not pin worker to core " << core << std::endl;
+	}
+#else
+	(void)core; // no portable way to do this; let the OS schedule us
+#endif
+}
+
+static void clearStats(WorkerStats &stats) {
+	std::memset(&stats, 0, sizeof(stats));
+}
+
+static void addStats(WorkerStats &total, const WorkerStats &stats) {
+	total.ticks += stats.ticks;
+	total.skippedTicks += stats.skippedTicks;
+	total.totalLatenessUs += stats.totalLatenessUs;
+	if (stats.maxLatenessUs > total.maxLatenessUs) {
+		total.maxLatenessUs = stats.maxLatenessUs;
+	}
+	total.busyUs += stats.busyUs;
+	total.cpuUs += stats.cpuUs;
+	total.finishedMatches += stats.finishedMatches;
+	for (int i = 0; i < SERVER_LATENESS_BUCKETS; ++i) {
+		total.latenessHistogram[i] += stats.latenessHistogram[i];
+	}
+}
+
+MatchServer::MatchServer(int matchCount, int workerCount, Uint16 port, bool aiVsAi) {
+	this->matchCount = matchCount;
+	this->aiVsAi = aiVsAi;
+	this->workerCount = workerCount;
+	this->workers = new Worker[workerCount];
+	for (int i = 0; i < workerCount; ++i) {
+		// each worker has its own pool, as pools aren't thread safe
+		const int workerMatches = (matchCount - i + workerCount - 1) / workerCount;
+		this->workers[i].pool = new MatchPool(workerMatches);
+		for (int j = 0; j < workerMatches; ++j) {
+			this->workers[i].pool->acquire(); // matches are acquired in order, so slot j is pool->get(j)
+		}
+	}
+
+	this->socket = SDLNet_UDP_Open(port);
+	if (this->socket == nullptr) {
+		logSDLError("SDLNet_UDP_Open");
+	}
+	this->socketSet = SDLNet_AllocSocketSet(1);
+	if (this->socketSet == nullptr) {
+		logSDLError("SDLNet_AllocSocketSet");
+	}
+	SDLNet_UDP_AddSocket(this->socketSet, this->socket);
+	this->packet = SDLNet_AllocPacket(16);
+	if (this->packet == nullptr) {
+		logSDLError("SDLNet_AllocPacket");
+	}
+
+	// spread the matches' ticks evenly over a timestep so the load is smooth rather than bursty
+	const Uint64 start = nowMicroseconds() + TIMESTEP_US;
+	for (int i = 0; i < matchCount; ++i) {
+		getMatch(i).dueTime = start + TIMESTEP_US * i / matchCount;
+	}
+
+	this->running = true;
+	for (int i = 0; i < workerCount; ++i) {
+		Worker &worker = this->workers[i];
+		worker.server = this;
+		worker.index = i;
+		clearStats(worker.stats);
+		worker.statsLock = SDL_CreateMutex();
+		if (worker.statsLock == nullptr) {
+			logSDLError("SDL_CreateMutex");
+		}
+		worker.thread = SDL_CreateThread(&MatchServer::workerMain, "match worker", &worker);
+		if (worker.thread == nullptr) {
+			logSDLError("SDL_CreateThread");
+		}
+	}
+	std::cout << "Serving " << matchCount << " matches on " << workerCount << " workers; inputs on port " << port << std::endl;
+}
+
+MatchServer::~MatchServer() {
+	this->running = false;
+	for (int i = 0; i < this->workerCount; ++i) {
+		SDL_WaitThread(this->workers[i].thread, nullptr);
+		SDL_DestroyMutex(this->workers[i].statsLock);
+		delete this->workers[i].pool;
+	}
+	delete[] this->workers;
+	SDLNet_FreePacket(this->packet);
+	SDLNet_FreeSocketSet(this->socketSet);
+	SDLNet_UDP_Close(this->socket);
+}
+
+int SDLCALL MatchServer::workerMain(void *data) {
+	Worker *worker = static_cast<Worker *>(data);
+	worker->server->runWorker(*worker);
+	return 0;
+}
+
+// the timer wheel tick in which a deadline falls due, rounded up so a timer never fires before its deadline
+static Uint64 wheelTickFor(Uint64 dueTime) {
+	return (dueTime + SERVER_TIMER_RESOLUTION_US - 1) / SERVER_TIMER_RESOLUTION_US;
+}
+
+// steps each match as its timer expires, then schedules its next tick. AiVsAi is a template parameter
+// (rather than a member) so who controls the human paddle is decided once per worker, not once per tick
+template<bool AiVsAi>
+struct StepExpiredMatches {
+	TimerWheel *wheel;
+	MatchPool *pool;
+	WorkerStats *stats;
+	ChaseAiController ai;
+
+	void operator()(TimerNode *node) {
+		Match *match = static_cast<Match *>(node->data);
+		const Uint64 now = nowMicroseconds();
+		// deviation either way from the deadline, so a tick which somehow ran early still shows up as jitter
+		const Uint64 lateness = now > match->dueTime ? now - match->dueTime : match->dueTime - now;
+
+		if (AiVsAi) {
+			match->world.update(match->state, PHYSICS_TIMESTEP, this->ai, this->ai);
+		} else {
+			match->world.update(match->state, PHYSICS_TIMESTEP, match->humanController, this->ai);
+		}
+		if (match->isFinished()) {
+			// the pool is full apart from this match, so the replacement is the same slot (with the same
+			// timer and dueTime), and so still answers to the same index for inputs
+			this->pool->release(match);
+			match = this->pool->acquire();
+			SDL_assert(&match->timer == node);
+			this->stats->finishedMatches += 1;
+		}
+
+		this->stats->ticks += 1;
+		this->stats->totalLatenessUs += lateness;
+		if (lateness > this->stats->maxLatenessUs) {
+			this->stats->maxLatenessUs = lateness;
+		}
+		int bucket = 0;
+		while (bucket < SERVER_LATENESS_BUCKETS - 1 && lateness >= LATENESS_BUCKET_LIMITS[bucket]) {
+			++bucket;
+		}
+		this->stats->latenessHistogram[bucket] += 1;
+
+		match->dueTime += TIMESTEP_US;
+		if (now > match->dueTime + TIMESTEP_US * SERVER_MAX_TICKS_BEHIND) {
+			// hopelessly behind (overloaded, or the machine was suspended); drop the missed ticks
+			const Uint64 skipped = (now - match->dueTime) / TIMESTEP_US;
+			this->stats->skippedTicks += skipped;
+			match->dueTime += skipped * TIMESTEP_US;
+		}
+		this->wheel->schedule(node, wheelTickFor(match->dueTime));
+	}
+};
+
+void MatchServer::runWorker(Worker &worker) {
+	pinCurrentThreadToCore(worker.index % SDL_GetCPUCount());
+
+	TimerWheel wheel(nowMicroseconds() / SERVER_TIMER_RESOLUTION_US);
+	for (int i = 0; i < worker.pool->getCapacity(); ++i) {
+		Match &match = worker.pool->get(i);
+		wheel.schedule(&match.timer, wheelTickFor(match.dueTime));
+	}
+
+	if (this->aiVsAi) {
+		StepExpiredMatches<true> step = { &wheel, worker.pool, nullptr, ChaseAiController() };
+		runWorkerLoop(worker, wheel, step);
+	} else {
+		StepExpiredMatches<false> step = { &wheel, worker.pool, nullptr, ChaseAiController() };
+		runWorkerLoop(worker, wheel, step);
+	}
+}
+
+template<typename Step>
+void MatchServer::runWorkerLoop(Worker &worker, TimerWheel &wheel, Step &step) {
+	WorkerStats stats;
+	clearStats(stats);
+	step.stats = &stats;
+	Uint64 lastPublished = nowMicroseconds();
+	Uint64 lastCpuUs = threadCpuMicroseconds();
+
+	while (this->running) {
+		const Uint64 start = nowMicroseconds();
+		wheel.advance(start / SERVER_TIMER_RESOLUTION_US, step);
+		const Uint64 finish = nowMicroseconds();
+		stats.busyUs += finish - start;
+
+		if (finish - lastPublished > 1000000) {
+			const Uint64 cpuUs = threadCpuMicroseconds();
+			stats.cpuUs = cpuUs - lastCpuUs;
+			lastCpuUs = cpuUs;
+			SDL_LockMutex(worker.statsLock);
+			addStats(worker.stats, stats);
+			SDL_UnlockMutex(worker.statsLock);
+			clearStats(stats);
+			lastPublished = finish;
+		}
+
+		// every match ticks each timestep, so the next deadline is never more than one timestep away and
+		// there's no need to wake up early to notice running has been cleared
+		waitUntil((wheel.getCurrent() + wheel.ticksUntilNext()) * SERVER_TIMER_RESOLUTION_US);
+	}
+}
+
+Match &MatchServer::getMatch(int index) {
+	return this->workers[index % this->workerCount].pool->get(index / this->workerCount);
+}
+
+void MatchServer::receiveInputs() {
+	while (SDLNet_UDP_Recv(this->socket, this->packet) > 0) {
+		if (this->packet->len < 6 || this->packet->data[0] != 'I') {
+			continue;
+		}
+		const Uint32 index = SDLNet_Read32(this->packet->data + 1);
+		const Sint8 direction = static_cast<Sint8>(this->packet->data[5]);
+		if (index < static_cast<Uint32>(this->matchCount) && direction >= -1 && direction <= 1) {
+			getMatch(index).input.store(direction, std::memory_order_relaxed);
+		}
+	}
+}
+
+void MatchServer::report(Uint32 elapsedMs) {
+	WorkerStats total;
+	clearStats(total);
+	for (int i = 0; i < this->workerCount; ++i) {
+		SDL_LockMutex(this->workers[i].statsLock);
+		addStats(total, this->workers[i].stats);
+		clearStats(this->workers[i].stats);
+		SDL_UnlockMutex(this->workers[i].statsLock);
+	}
+	if (total.ticks == 0) {
+		return;
+	}
+
+	// the lateness below which 99% of ticks ran
+	Uint64 p99Limit = 0;
+	Uint64 seen = 0;
+	for (int i = 0; i < SERVER_LATENESS_BUCKETS; ++i) {
+		seen += total.latenessHistogram[i];
+		if (seen * 100 >= total.ticks * 99) {
+			p99Limit = i < SERVER_LATENESS_BUCKETS - 1 ? LATENESS_BUCKET_LIMITS[i] : total.maxLatenessUs;
+			break;
+		}
+	}
+
+	const double elapsedUs = elapsedMs * 1000.0;
+	const double utilisation = total.busyUs / (elapsedUs * this->workerCount);
+	const double cpuLoad = total.cpuUs / (elapsedUs * this->workerCount);
+	const double matchesPerCore = utilisation > 0 ? this->matchCount / (this->workerCount * utilisation) : 0;
+	std::cout << "ticks/s: " << static_cast<Uint64>(total.ticks * 1000.0 / elapsedMs)
+		<< " (want " << static_cast<Uint64>(this->matchCount / PHYSICS_TIMESTEP) << ")"
+		<< " | jitter mean " << total.totalLatenessUs / total.ticks << "us"
+		<< " p99 <" << p99Limit << "us max " << total.maxLatenessUs << "us"
+		<< " | worker cpu " << static_cast<int>(cpuLoad * 100) << "%"
+		<< " | skipped " << total.skippedTicks
+		<< " | matches finished/s " << static_cast<Uint64>(total.finishedMatches * 1000.0 / elapsedMs)
+		<< " | worker busy " << static_cast<int>(utilisation * 100) << "%"
+		<< " | capacity ~" << static_cast<Uint64>(matchesPerCore) << " matches/core" << std::endl;
+}
+
+void MatchServer::run(Uint32 durationMs) {
+	const Uint32 started = SDL_GetTicks();
+	Uint32 lastReport = started;
+	bool quit = false;
+	while (!quit) {
+		if (SDLNet_CheckSockets(this->socketSet, 100) > 0) {
+			receiveInputs();
+		}
+
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT) {
+				quit = true;
+			}
+		}
+
+		const Uint32 now = SDL_GetTicks();
+		if (now - lastReport >= SERVER_REPORT_INTERVAL_MS) {
+			report(now - lastReport);
+			lastReport = now;
+		}
+		if (durationMs != 0 && now - started >= durationMs) {
+			quit = true;
+		}
+	}
+}
+
+int runLoadGenerator(const char *host, Uint16 port, int matchCount, Uint32 durationMs) {
+	IPaddress server;
+	if (SDLNet_ResolveHost(&server, host, port) != 0) {
+		logSDLError("SDLNet_ResolveHost");
+	}
+	UDPsocket socket = SDLNet_UDP_Open(0);
+	if (socket == nullptr) {
+		logSDLError("SDLNet_UDP_Open");
+	}
+	UDPpacket *packet = SDLNet_AllocPacket(16);
+	if (packet == nullptr) {
+		logSDLError("SDLNet_AllocPacket");
+	}
+	packet->address = server;
+	packet->len = 6;
+	packet->data[0] = 'I';
+
+	std::cout << "Sending inputs for " << matchCount << " matches to " << host << ":" << port << std::endl;
+
+	// each simulated player changes direction a few times a second, like someone tapping arrow keys
+	const Uint32 sendIntervalMs = 50;
+	const Uint32 started = SDL_GetTicks();
+	Uint32 lastReport = started;
+	Uint64 sent = 0;
+	bool quit = false;
+	while (!quit) {
+		const Uint32 frameStart = SDL_GetTicks();
+		for (int i = 0; i < matchCount; ++i) {
+			if (randomIntInRange(0, 3) != 0) {
+				continue;
+			}
+			SDLNet_Write32(static_cast<Uint32>(i), packet->data + 1);
+			packet->data[5] = static_cast<Uint8>(static_cast<Sint8>(randomIntInRange(-1, 1)));
+			SDLNet_UDP_Send(socket, -1, packet);
+			++sent;
+		}
+
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT) {
+				quit = true;
+			}
+		}
+
+		const Uint32 now = SDL_GetTicks();
+		if (now - lastReport >= SERVER_REPORT_INTERVAL_MS) {
+			std::cout << "inputs/s: " << sent * 1000 / (now - lastReport) << std::endl;
+			sent = 0;
+			lastReport = now;
+		}
+		if (durationMs != 0 && now - started >= durationMs) {
+			quit = true;
+		}
+		const Uint32 frameTime = now - frameStart;
+		if (frameTime < sendIntervalMs) {
+			SDL_Delay(sendIntervalMs - frameTime);
+		}
+	}
+
+	SDLNet_FreePacket(packet);
+	SDLNet_UDP_Close(socket);
+	return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+
+#include <SDL.h>
+#include <SDL_net.h>
+
+#include "util.h"
+#include "world.h"
+#include "controllers.h"
+#include "timer_wheel.h"
+#include "match_pool.h"
+
+#define SERVER_DEFAULT_PORT 7778
+#define SERVER_TIMER_RESOLUTION_US 250 // length of one timer wheel tick; matches tick up to this late
+#define SERVER_MAX_TICKS_BEHIND 10 // a match further behind than this skips ahead instead of catching up
+#define SERVER_REPORT_INTERVAL_MS 5000
+#define SERVER_LATENESS_BUCKETS 8
+
+/*
+* Input protocol (UDP, big endian): 'I' u32 matchIndex s8 direction
+* where direction is -1 for up, 1 for down and 0 to stop; it applies to the match's human paddle.
+*/
+
+/* What a worker has been up to since its stats were last collected */
+struct WorkerStats {
+	Uint64 ticks;
+	Uint64 skippedTicks;
+	Uint64 totalLatenessUs;
+	Uint64 maxLatenessUs;
+	Uint64 busyUs; // spent ticking matches
+	Uint64 cpuUs; // of CPU time used, including waiting for the next tick
+	Uint64 finishedMatches;
+	Uint64 latenessHistogram[SERVER_LATENESS_BUCKETS];
+};
+
+/**
+* Hosts many concurrent matches in one headless process. Matches are split evenly between worker
+* threads (one per core by default, each pinned to its core); each worker drives its own matches from
+* its own timer wheel, so workers never share anything but their stats. The calling thread receives
+* inputs and periodically reports per-tick jitter, how much CPU the workers use and how many matches a core
+* could sustain. Between ticks a worker sleeps until just before the next one is due, then spins briefly.
+*
+* With aiVsAi, both paddles in every match chase the ball and inputs are ignored. Either way, a match
+* which finishes goes back to its worker's MatchPool and a fresh one is acquired to take its place.
+*/
+class MatchServer {
+public:
+	MatchServer(int matchCount, int workerCount, Uint16 port, bool aiVsAi);
+	~MatchServer();
+
+	/**
+	* Runs until the process is asked to quit.
+	* @param durationMs stop after this long, or 0 to run indefinitely
+	*/
+	void run(Uint32 durationMs);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(MatchServer);
+
+	struct Worker {
+		MatchServer *server;
+		int index;
+		SDL_Thread *thread;
+		MatchPool *pool; // this worker's matches: match i is on worker i % workerCount, in slot i / workerCount
+		SDL_mutex *statsLock;
+		WorkerStats stats;
+	};
+
+	int matchCount;
+	bool aiVsAi;
+	int workerCount;
+	Worker *workers;
+	std::atomic<bool> running;
+	UDPsocket socket;
+	SDLNet_SocketSet socketSet;
+	UDPpacket *packet;
+
+	static int SDLCALL workerMain(void *data);
+	void runWorker(Worker &worker);
+	// runWorker's main loop, for a given StepExpiredMatches
+	template<typename Step>
+	void runWorkerLoop(Worker &worker, TimerWheel &wheel, Step &step);
+	Match &getMatch(int index);
+	void receiveInputs();
+	void report(Uint32 elapsedMs);
+};
+
+/**
+* Simulates clients for a MatchServer: sends a changing stream of inputs for every match.
+* @return the process exit code
+*/
+int runLoadGenerator(const char *host, Uint16 port, int matchCount, Uint32 durationMs);
+
+#endif
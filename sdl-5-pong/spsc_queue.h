@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+
+#include "util.h"
+
+#define CACHE_LINE_SIZE 64
+
+/**
+* Bounded single-producer/single-consumer queue. push() may only be called from one thread and pop()
+* from one (other) thread; neither ever blocks, locks or allocates, so it's safe to use from inside
+* the SDL audio callback.
+* @tparam T the element type; should be cheap to copy
+* @tparam Capacity number of slots; must be a power of two. One slot is kept empty to tell full from empty.
+*/
+template <typename T, unsigned int Capacity>
+class SpscQueue {
+public:
+	SpscQueue() : head(0), tail(0) {
+		static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+	}
+
+	/**
+	* @return false if the queue was full (in which case the item is dropped)
+	*/
+	bool push(const T &item) {
+		const unsigned int currentTail = this->tail.load(std::memory_order_relaxed);
+		const unsigned int nextTail = (currentTail + 1) & (Capacity - 1);
+		if (nextTail == this->head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		this->items[currentTail] = item;
+		this->tail.store(nextTail, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	* @return false if the queue was empty (in which case item is left untouched)
+	*/
+	bool pop(T &item) {
+		const unsigned int currentHead = this->head.load(std::memory_order_relaxed);
+		if (currentHead == this->tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = this->items[currentHead];
+		this->head.store((currentHead + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(SpscQueue);
+	// head and tail live on separate cache lines so producer and consumer don't false-share
+	std::atomic<unsigned int> head;
+	char headPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned int>)];
+	std::atomic<unsigned int> tail;
+	char tailPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned int>)];
+	T items[Capacity];
+};
+
+#endif
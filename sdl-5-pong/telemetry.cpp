@@ -0,0 +1,235 @@
+#include <iostream>
+#include <cstring>
+#include <new>
+
+#include <SDL.h>
+
+#include "telemetry.h"
+#include "util.h"
+
+#ifdef __WIN32__
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __WIN32__
+#define TELEMETRY_SHM_NAME "Local\\" TELEMETRY_NAME
+#else
+#define TELEMETRY_SHM_NAME "/" TELEMETRY_NAME
+#endif
+
+// how many times to retry a slot the publisher is writing before giving up on it. A write is a few dozen
+// bytes, so this is only ever reached if the publisher died (or was suspended) halfway through one
+const int TELEMETRY_MAX_READ_RETRIES = 1000;
+
+// the sequence counters are shared with another process, which only works if they're real atomic
+// instructions rather than a lock that lives in this process
+static bool telemetryAtomicsAreLockFree() {
+	std::atomic<Uint32> probe(0);
+	return probe.is_lock_free();
+}
+
+// maps the shared memory segment, creating it if asked to. Returns nullptr on failure.
+static TelemetryBuffer *mapTelemetryBuffer(bool create, void **handle) {
+	const size_t size = sizeof(TelemetryBuffer);
+	*handle = nullptr;
+#ifdef __WIN32__
+	HANDLE mapping;
+	if (create) {
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			0, static_cast<DWORD>(size), TELEMETRY_SHM_NAME);
+	} else {
+		mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, TELEMETRY_SHM_NAME);
+	}
+	if (mapping == nullptr) {
+		return nullptr;
+	}
+	void *memory = MapViewOfFile(mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+	if (memory == nullptr) {
+		CloseHandle(mapping);
+		return nullptr;
+	}
+	*handle = mapping;
+#else
+	int fd = create ? shm_open(TELEMETRY_SHM_NAME, O_CREAT | O_RDWR, 0644) : shm_open(TELEMETRY_SHM_NAME, O_RDONLY, 0);
+	if (fd == -1) {
+		return nullptr;
+	}
+	if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		close(fd);
+		return nullptr;
+	}
+	void *memory = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the segment alive
+	if (memory == MAP_FAILED) {
+		return nullptr;
+	}
+#endif
+	return static_cast<TelemetryBuffer *>(memory);
+}
+
+static void unmapTelemetryBuffer(TelemetryBuffer *buffer, void *handle, bool destroy) {
+#ifdef __WIN32__
+	(void)destroy; // the mapping goes away with its last handle
+	UnmapViewOfFile(buffer);
+	CloseHandle(static_cast<HANDLE>(handle));
+#else
+	(void)handle;
+	munmap(buffer, sizeof(TelemetryBuffer));
+	if (destroy) {
+		shm_unlink(TELEMETRY_SHM_NAME);
+	}
+#endif
+}
+
+TelemetryPublisher::TelemetryPublisher() {
+	this->buffer = nullptr;
+	this->handle = nullptr;
+	if (!telemetryAtomicsAreLockFree()) {
+		std::cerr << "Atomics aren't lock-free on this platform, so can't be shared between processes; telemetry disabled" << std::endl;
+		return;
+	}
+	this->buffer = mapTelemetryBuffer(true, &this->handle);
+	if (this->buffer == nullptr) {
+		std::cerr << "Could not create telemetry shared memory " << TELEMETRY_SHM_NAME << "; telemetry disabled" << std::endl;
+		return;
+	}
+
+	this->buffer->magic = 0; // so readers ignore the buffer until it's set up
+	std::atomic_thread_fence(std::memory_order_release);
+	this->buffer->version = TELEMETRY_VERSION;
+	this->buffer->capacity = TELEMETRY_CAPACITY;
+	new (&this->buffer->published) std::atomic<Uint32>(0);
+	for (int i = 0; i < TELEMETRY_CAPACITY; ++i) {
+		new (&this->buffer->slots[i].sequence) std::atomic<Uint32>(0);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	this->buffer->magic = TELEMETRY_MAGIC;
+	std::cout << "Publishing telemetry to " << TELEMETRY_SHM_NAME << std::endl;
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+	if (this->buffer != nullptr) {
+		this->buffer->magic = 0; // tells readers we've gone away
+		unmapTelemetryBuffer(this->buffer, this->handle, true);
+	}
+}
+
+bool TelemetryPublisher::isOpen() const {
+	return this->buffer != nullptr;
+}
+
+void TelemetryPublisher::publish(const TelemetrySample &sample) {
+	if (this->buffer == nullptr) {
+		return;
+	}
+	const Uint32 index = this->buffer->published.load(std::memory_order_relaxed);
+	TelemetrySlot &slot = this->buffer->slots[index & (TELEMETRY_CAPACITY - 1)];
+
+	const Uint32 sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.index = index;
+	slot.sample = sample;
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+
+	this->buffer->published.store(index + 1, std::memory_order_release);
+}
+
+TelemetryReader::TelemetryReader() {
+	this->cursor = 0;
+	this->buffer = nullptr;
+	this->handle = nullptr;
+	if (!telemetryAtomicsAreLockFree()) {
+		return;
+	}
+	this->buffer = mapTelemetryBuffer(false, &this->handle);
+	if (this->buffer != nullptr && (this->buffer->magic != TELEMETRY_MAGIC || this->buffer->version != TELEMETRY_VERSION)) {
+		unmapTelemetryBuffer(this->buffer, this->handle, false);
+		this->buffer = nullptr;
+	}
+	if (this->buffer != nullptr) {
+		// start from whatever's in the ring right now
+		const Uint32 published = this->buffer->published.load(std::memory_order_acquire);
+		this->cursor = published > TELEMETRY_CAPACITY ? published - TELEMETRY_CAPACITY : 0;
+	}
+}
+
+TelemetryReader::~TelemetryReader() {
+	if (this->buffer != nullptr) {
+		unmapTelemetryBuffer(this->buffer, this->handle, false);
+	}
+}
+
+bool TelemetryReader::isOpen() const {
+	return this->buffer != nullptr && this->buffer->magic == TELEMETRY_MAGIC;
+}
+
+bool TelemetryReader::readSlot(Uint32 index, TelemetrySample &sample) {
+	const TelemetrySlot &slot = this->buffer->slots[index & (TELEMETRY_CAPACITY - 1)];
+	for (int attempt = 0; attempt < TELEMETRY_MAX_READ_RETRIES; ++attempt) {
+		const Uint32 before = slot.sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			continue; // publisher is mid-write; it never takes long
+		}
+		const Uint32 slotIndex = slot.index;
+		std::memcpy(&sample, &slot.sample, sizeof(sample));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == before) {
+			// a slot that has since been reused for a newer sample means we were lapped
+			return slotIndex == index;
+		}
+	}
+	return false; // the publisher never finished writing it; skip the slot
+}
+
+int TelemetryReader::readNew(TelemetrySample *out, int maxSamples) {
+	if (!isOpen()) {
+		return 0;
+	}
+	const Uint32 published = this->buffer->published.load(std::memory_order_acquire);
+	if (published - this->cursor > TELEMETRY_CAPACITY) {
+		this->cursor = published - TELEMETRY_CAPACITY; // fell behind; skip what's been overwritten
+	}
+
+	int count = 0;
+	while (this->cursor != published && count < maxSamples) {
+		if (readSlot(this->cursor, out[count])) {
+			++count;
+		}
+		++this->cursor;
+	}
+	return count;
+}
+
+int runTelemetryMonitor() {
+	TelemetryReader reader;
+	if (!reader.isOpen()) {
+		std::cerr << "No telemetry found at " << TELEMETRY_SHM_NAME << " - is the game running with --telemetry?" << std::endl;
+		return 1;
+	}
+
+	std::cout << "tick,substeps,frame_us,input_us,simulate_us,render_us,present_us,"
+		<< "ball_speed_x,ball_speed_y,human_score,opponent_score,clamped_frames,multistep_frames,"
+		<< "time_scale,dropped_us,over_budget_frames" << std::endl;
+	TelemetrySample samples[256];
+	while (reader.isOpen()) {
+		const int count = reader.readNew(samples, 256);
+		for (int i = 0; i < count; ++i) {
+			const TelemetrySample &s = samples[i];
+			std::cout << s.tick << "," << s.substeps << "," << s.frameTime << "," << s.inputTime << ","
+				<< s.simulateTime << "," << s.renderTime << "," << s.presentTime << ","
+				<< s.ballSpeedX << "," << s.ballSpeedY << "," << s.humanScore << "," << s.opponentScore << ","
+				<< s.clampedFrames << "," << s.multiStepFrames << ","
+				<< s.timeScale << "," << s.droppedTime << "," << s.overBudgetFrames << "\n";
+		}
+		std::cout.flush();
+		SDL_Delay(50);
+	}
+	std::cerr << "Game exited" << std::endl;
+	return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+
+#include <SDL.h>
+
+#include "util.h"
+
+#define TELEMETRY_NAME "sdl-pong-telemetry"
+#define TELEMETRY_MAGIC 0x474E4F50 // "PONG"
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_CAPACITY 1024 // must be a power of two
+
+/* One frame's worth of metrics. Times are in microseconds. */
+struct TelemetrySample {
+	Uint32 tick;
+	Uint32 substeps;
+	float frameTime;
+	float inputTime;
+	float simulateTime;
+	float renderTime;
+	float presentTime;
+	float ballSpeedX;
+	float ballSpeedY;
+	Sint32 humanScore;
+	Sint32 opponentScore;
+	Uint32 clampedFrames; // frames where deltaTime was capped, i.e. game time was thrown away
+	Uint32 multiStepFrames; // frames which had to run more than one substep to catch up
+	float timeScale; // game seconds per real second
+	float droppedTime; // game time dropped this frame because simulating it would have gone over budget
+	Uint32 overBudgetFrames; // frames which dropped game time
+};
+
+/* A ring slot guarded by a seqlock: the sequence is odd while the publisher is writing to it */
+struct TelemetrySlot {
+	std::atomic<Uint32> sequence;
+	Uint32 index; // which sample this is, so readers can tell if they've been lapped
+	TelemetrySample sample;
+};
+
+/* The layout of the shared memory segment */
+struct TelemetryBuffer {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 capacity;
+	std::atomic<Uint32> published; // total samples ever published; the latest is at (published - 1) % capacity
+	TelemetrySlot slots[TELEMETRY_CAPACITY];
+};
+
+/**
+* Publishes per-frame telemetry into a named shared memory ring buffer for an external monitor to read.
+* publish() is wait-free: it never blocks on or even looks at readers, and readers detect (and retry on)
+* torn reads themselves.
+*/
+class TelemetryPublisher {
+public:
+	TelemetryPublisher();
+	~TelemetryPublisher();
+
+	/* @return false if the shared memory segment couldn't be created, in which case publish() does nothing */
+	bool isOpen() const;
+
+	void publish(const TelemetrySample &sample);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(TelemetryPublisher);
+	TelemetryBuffer *buffer;
+	void *handle;
+};
+
+/* Reads telemetry published by another process */
+class TelemetryReader {
+public:
+	TelemetryReader();
+	~TelemetryReader();
+
+	/* @return false if no game is currently publishing telemetry */
+	bool isOpen() const;
+
+	/**
+	* Copies out every sample published since the last call (or the last TELEMETRY_CAPACITY of them, if
+	* the reader fell behind).
+	* @param out where to copy samples to
+	* @param maxSamples the size of out
+	* @return the number of samples copied
+	*/
+	int readNew(TelemetrySample *out, int maxSamples);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(TelemetryReader);
+	TelemetryBuffer *buffer;
+	void *handle;
+	Uint32 cursor;
+
+	// copies one slot out; false if it was overwritten, or is stuck half-written
+	bool readSlot(Uint32 index, TelemetrySample &sample);
+};
+
+/**
+* Runs a console monitor which prints live telemetry from a running game as CSV, until the game exits.
+* @return the process exit code
+*/
+int runTelemetryMonitor();
+
+#endif
@@ -0,0 +1,89 @@
+#include "timer_wheel.h"
+
+TimerNode::TimerNode() {
+	this->deadline = 0;
+	this->data = nullptr;
+	this->prev = nullptr;
+	this->next = nullptr;
+}
+
+bool TimerNode::isScheduled() const {
+	return this->next != nullptr;
+}
+
+TimerWheel::TimerWheel(Uint64 now) {
+	this->current = now;
+	for (int i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+		this->inner[i].prev = this->inner[i].next = &this->inner[i];
+		this->outer[i].prev = this->outer[i].next = &this->outer[i];
+	}
+}
+
+void TimerWheel::link(TimerNode *head, TimerNode *node) {
+	node->prev = head->prev;
+	node->next = head;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+void TimerWheel::unlink(TimerNode *node) {
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->prev = nullptr;
+	node->next = nullptr;
+}
+
+void TimerWheel::schedule(TimerNode *node, Uint64 deadline) {
+	if (node->isScheduled()) {
+		unlink(node);
+	}
+	node->deadline = deadline;
+	if (deadline < this->current) {
+		deadline = this->current;
+	}
+
+	const Uint64 ticksAway = deadline - this->current;
+	if (ticksAway < TIMER_WHEEL_SLOTS) {
+		link(&this->inner[deadline & (TIMER_WHEEL_SLOTS - 1)], node);
+	} else if (ticksAway < (TIMER_WHEEL_SLOTS - 1) * TIMER_WHEEL_SLOTS) {
+		link(&this->outer[(deadline >> TIMER_WHEEL_BITS) & (TIMER_WHEEL_SLOTS - 1)], node);
+	} else {
+		// too far out; park it in the last outer slot to be re-filed when that comes around
+		const Uint64 lastSlot = (this->current >> TIMER_WHEEL_BITS) + TIMER_WHEEL_SLOTS - 1;
+		link(&this->outer[lastSlot & (TIMER_WHEEL_SLOTS - 1)], node);
+	}
+}
+
+void TimerWheel::cancel(TimerNode *node) {
+	if (node->isScheduled()) {
+		unlink(node);
+	}
+}
+
+void TimerWheel::cascade() {
+	// current has just wrapped the inner wheel, so the outer slot for this lap now fits in the inner wheel
+	TimerNode *slot = &this->outer[(this->current >> TIMER_WHEEL_BITS) & (TIMER_WHEEL_SLOTS - 1)];
+	while (slot->next != slot) {
+		TimerNode *node = slot->next;
+		unlink(node);
+		schedule(node, node->deadline);
+	}
+}
+
+Uint64 TimerWheel::getCurrent() const {
+	return this->current;
+}
+
+Uint64 TimerWheel::ticksUntilNext() const {
+	for (Uint64 i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+		const TimerNode *slot = &this->inner[(this->current + i) & (TIMER_WHEEL_SLOTS - 1)];
+		if (slot->next != slot) {
+			return i;
+		}
+		// don't look past the next cascade; anything beyond it is still in the outer wheel
+		if (((this->current + i + 1) & (TIMER_WHEEL_SLOTS - 1)) == 0) {
+			return i + 1;
+		}
+	}
+	return TIMER_WHEEL_SLOTS;
+}
@@ -0,0 +1,81 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <SDL.h>
+
+#include "util.h"
+
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+/**
+* A timer, embedded in whatever it's timing so scheduling never allocates. Deadlines are in wheel ticks,
+* whose length is up to the wheel's owner.
+*/
+class TimerNode {
+public:
+	Uint64 deadline;
+	void *data; // for the owner's use, e.g. pointing back at the thing being timed
+
+	TimerNode();
+
+	bool isScheduled() const;
+
+private:
+	friend class TimerWheel;
+	TimerNode *prev;
+	TimerNode *next;
+};
+
+/**
+* Two level hierarchical timer wheel: the inner level has one slot per tick for the next 256 ticks, the
+* outer level one slot per 256 ticks for the next 65536. Timers further out than that park in the last
+* outer slot and get re-filed when it comes around. Scheduling, cancelling and expiring are all O(1).
+*/
+class TimerWheel {
+public:
+	/* @param now the current time in wheel ticks */
+	explicit TimerWheel(Uint64 now);
+
+	/* (Re)schedules node to expire at its deadline. Deadlines in the past expire on the next advance(). */
+	void schedule(TimerNode *node, Uint64 deadline);
+	void cancel(TimerNode *node);
+
+	/**
+	* Moves the wheel forward to now, unlinking every timer which has expired.
+	* @param now the current time in wheel ticks
+	* @param expired called with each expired node; may reschedule it
+	*/
+	template <typename Callback>
+	void advance(Uint64 now, Callback &expired) {
+		while (this->current <= now) {
+			TimerNode *slot = &this->inner[this->current & (TIMER_WHEEL_SLOTS - 1)];
+			while (slot->next != slot) {
+				TimerNode *node = slot->next;
+				unlink(node);
+				expired(node);
+			}
+			++this->current;
+			if ((this->current & (TIMER_WHEEL_SLOTS - 1)) == 0) {
+				cascade();
+			}
+		}
+	}
+
+	/* @return how many ticks from now until the earliest timer in the inner wheel (at most 256) */
+	Uint64 ticksUntilNext() const;
+	/* @return the first tick the next advance() will process */
+	Uint64 getCurrent() const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+	Uint64 current; // every tick before this one has been processed
+	TimerNode inner[TIMER_WHEEL_SLOTS]; // slot heads of circular lists
+	TimerNode outer[TIMER_WHEEL_SLOTS];
+
+	void unlink(TimerNode *node);
+	void link(TimerNode *head, TimerNode *node);
+	void cascade();
+};
+
+#endif
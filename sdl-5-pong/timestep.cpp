@@ -0,0 +1,75 @@
+#include "timestep.h"
+
+// how much each new measurement moves the average step cost; small enough to ride out the odd slow step
+const float STEP_COST_SMOOTHING = 0.1f;
+
+FixedTimestep::FixedTimestep(float timestep, float budget) {
+	this->timestep = timestep;
+	this->budget = budget;
+	this->timeScale = 1.0f;
+	this->accumulator = 0;
+	this->averageStepCost = 0;
+	this->overBudget = false;
+	this->droppedTime = 0;
+}
+
+int FixedTimestep::advance(float frameTime) {
+	this->accumulator += frameTime * this->timeScale;
+	int steps = static_cast<int>(this->accumulator / this->timestep);
+
+	// always allow one step, otherwise a single very slow step would stop the game forever
+	int affordable = steps;
+	if (this->averageStepCost > 0) {
+		affordable = static_cast<int>(this->budget / this->averageStepCost);
+		if (affordable < 1) {
+			affordable = 1;
+		}
+	}
+
+	this->overBudget = steps > affordable;
+	if (this->overBudget) {
+		const float dropped = (steps - affordable) * this->timestep;
+		this->accumulator -= dropped;
+		this->droppedTime += dropped;
+		steps = affordable;
+	}
+	this->accumulator -= steps * this->timestep;
+	return steps;
+}
+
+void FixedTimestep::measured(float simulateTime, int steps) {
+	if (steps <= 0) {
+		return;
+	}
+	const float stepCost = simulateTime / steps;
+	if (this->averageStepCost == 0) {
+		this->averageStepCost = stepCost;
+	} else {
+		this->averageStepCost += (stepCost - this->averageStepCost) * STEP_COST_SMOOTHING;
+	}
+}
+
+float FixedTimestep::getAlpha() const {
+	return this->accumulator / this->timestep;
+}
+
+float FixedTimestep::getTimeScale() const {
+	return this->timeScale;
+}
+
+void FixedTimestep::setTimeScale(float timeScale) {
+	if (timeScale < TIMESTEP_MIN_SCALE) {
+		timeScale = TIMESTEP_MIN_SCALE;
+	} else if (timeScale > TIMESTEP_MAX_SCALE) {
+		timeScale = TIMESTEP_MAX_SCALE;
+	}
+	this->timeScale = timeScale;
+}
+
+bool FixedTimestep::isOverBudget() const {
+	return this->overBudget;
+}
+
+float FixedTimestep::getDroppedTime() const {
+	return this->droppedTime;
+}
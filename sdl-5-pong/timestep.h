@@ -0,0 +1,57 @@
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+#include <SDL.h>
+
+#include "util.h"
+
+#define TIMESTEP_MIN_SCALE 0.25f
+#define TIMESTEP_MAX_SCALE 16.0f
+
+/**
+* Decides how many fixed physics steps to simulate each frame (see
+* http://gafferongames.com/game-physics/fix-your-timestep/), with game time running at some multiple of
+* real time.
+*
+* It also keeps a running average of what a step costs, and won't schedule more steps in a frame than fit
+* in the simulation budget. When the simulation can't keep up, the time it can't get through is dropped:
+* the game runs slower than it should for a while, rather than frames taking longer and longer.
+*/
+class FixedTimestep {
+public:
+	/**
+	* @param timestep the length of one step, in seconds of game time
+	* @param budget how long to spend simulating each frame, in seconds of real time
+	*/
+	FixedTimestep(float timestep, float budget);
+
+	/**
+	* Adds a frame's worth of real time.
+	* @return how many steps to simulate this frame
+	*/
+	int advance(float frameTime);
+	/* Reports how long (in seconds) the steps from the last advance() took to simulate */
+	void measured(float simulateTime, int steps);
+
+	/* @return how far between the last two steps (0 to 1) the current time is, for interpolation */
+	float getAlpha() const;
+	float getTimeScale() const;
+	/* @param timeScale game seconds per real second; clamped to TIMESTEP_MIN_SCALE - TIMESTEP_MAX_SCALE */
+	void setTimeScale(float timeScale);
+	/* @return true if the last advance() had to drop time because it was over budget */
+	bool isOverBudget() const;
+	/* @return the total game time dropped for being over budget, in seconds */
+	float getDroppedTime() const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(FixedTimestep);
+	float timestep;
+	float budget;
+	float timeScale;
+	float accumulator; // game time not yet simulated
+	float averageStepCost; // exponential moving average, in seconds; 0 until the first measurement
+	bool overBudget;
+	float droppedTime;
+};
+
+#endif
@@ -90,18 +90,39 @@ int randomSignForInt() {
 	return randomIntInRange(0, 1) * 2 - 1;
 }
 
+Uint32 createRandomState() {
+	// RAND_MAX can be as small as 32767, so use two calls' worth
+	const Uint32 state = (static_cast<Uint32>(rand()) << 16) ^ static_cast<Uint32>(rand());
+	return state != 0 ? state : 1; // xorshift never leaves 0
+}
+
+Uint32 nextRandom(Uint32 &state) {
+	// Marsaglia, "Xorshift RNGs", 2003
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+int randomIntInRange(Uint32 &state, int min, int max) {
+	double uniformDeviate = nextRandom(state) * (1.0 / 4294967296.0);
+	int generatedRandom = static_cast<int>(min + uniformDeviate * (max + 1 - min));
+	SDL_assert(generatedRandom >= min);
+	SDL_assert(generatedRandom <= max);
+	return generatedRandom;
+}
+
+int randomSignForInt(Uint32 &state) {
+	return randomIntInRange(state, 0, 1) * 2 - 1;
+}
+
 FpsTracker::FpsTracker(int numberOfSamples) {
 	this->frameIndex = 0;
 	this->totalFrameTime = 0;
-	this->frameTimes = new float[numberOfSamples];
-	this->numberOfSamples = numberOfSamples;
+	this->numberOfSamples = numberOfSamples < FPS_TRACKER_MAX_SAMPLES ? numberOfSamples : FPS_TRACKER_MAX_SAMPLES;
 	this->samplesSoFar = 0;
 }
 
-FpsTracker::~FpsTracker() {
-	delete[] frameTimes;
-}
-
 float FpsTracker::calculateAverageFrameTime(float frameTime) {
 	if (this->samplesSoFar < this->numberOfSamples) {
 		this->samplesSoFar += 1;
@@ -75,10 +75,23 @@ int randomIntInRange(int min, int max);
 /* Has a 50/50 chance of returning 1 or -1 */ 
 int randomSignForInt();
 
+/**
+* The functions above share rand()'s single global state, which is locked (or, with some C runtimes, not
+* shared between threads at all). These take their state as an argument instead, so each match can have
+* its own generator: see WorldState::randomState.
+*/
+Uint32 createRandomState();
+/* xorshift32: returns the next number from state, and advances it */
+Uint32 nextRandom(Uint32 &state);
+int randomIntInRange(Uint32 &state, int min, int max);
+int randomSignForInt(Uint32 &state);
+
+#define FPS_TRACKER_MAX_SAMPLES 100
+
 class FpsTracker {
 public:
+	/* @param numberOfSamples how many frames to average over (no more than FPS_TRACKER_MAX_SAMPLES) */
 	explicit FpsTracker(int numberOfSamples);
-	~FpsTracker();
 	/**
 	* @param frameTime the current frame count
 	* @return the running average of the provided frame times
@@ -89,7 +102,7 @@ private:
 	DISALLOW_COPY_AND_ASSIGN(FpsTracker);
 	int frameIndex;
 	float totalFrameTime;
-	float *frameTimes;
+	float frameTimes[FPS_TRACKER_MAX_SAMPLES];
 	int numberOfSamples;
 	int samplesSoFar;
 };
@@ -0,0 +1,164 @@
+#include <cmath>
+#include <string>
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include "wall.h"
+#include "util.h"
+
+const Uint32 VIEWPORT_BACKGROUND = 0xFF181818; // so you can tell where one match ends and the next begins
+const int VIEWPORT_GAP = 2; // pixels between viewports
+const float SCORE_FONT_FRACTION = 0.12f; // of the viewport's height
+
+DigitAtlas::DigitAtlas(int fontSize) {
+	TTF_Font *font = TTF_OpenFont("Vera.ttf", fontSize > 1 ? fontSize : 1);
+	if (font == nullptr) {
+		logSDLError("TTF_OpenFont");
+	}
+	const SDL_Color color = { 0, 0, 255, 255 };
+	for (int i = 0; i < 10; ++i) {
+		const char text[2] = { static_cast<char>('0' + i), '\0' };
+		SDL_Surface *surface = TTF_RenderText_Blended(font, text, color);
+		if (surface == nullptr) {
+			logSDLError("TTF_RenderText_Blended");
+		}
+		this->digits[i] = new Sprite(std::string("digit ") + text, surface);
+		SDL_FreeSurface(surface);
+	}
+	TTF_CloseFont(font);
+	this->digitWidth = this->digits[0]->width;
+	this->digitHeight = this->digits[0]->height;
+}
+
+DigitAtlas::~DigitAtlas() {
+	for (int i = 0; i < 10; ++i) {
+		delete this->digits[i];
+	}
+}
+
+void DigitAtlas::drawNumber(Compositor &compositor, int number, int x, int y, AlignH alignH, AlignV alignV) const {
+	int digitCount = 1;
+	for (int rest = number / 10; rest > 0; rest /= 10) {
+		++digitCount;
+	}
+
+	const int width = digitCount * this->digitWidth;
+	if (alignH == AlignH::Center) {
+		x -= width / 2;
+	} else if (alignH == AlignH::Right) {
+		x -= width;
+	}
+	if (alignV == AlignV::Center) {
+		y -= this->digitHeight / 2;
+	} else if (alignV == AlignV::Bottom) {
+		y -= this->digitHeight;
+	}
+
+	// right to left, least significant digit first
+	x += width - this->digitWidth;
+	do {
+		compositor.drawSprite(this->digits[number % 10], x, y);
+		number /= 10;
+		x -= this->digitWidth;
+	} while (number > 0);
+}
+
+// lays matchCount viewports out in as square a grid as possible, and works out how big each one can be
+static void layOut(int matchCount, int width, int height, int &columns, int &cellWidth, int &cellHeight,
+		int &fieldWidth, int &fieldHeight) {
+	columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(matchCount))));
+	const int rows = (matchCount + columns - 1) / columns;
+	cellWidth = width / columns;
+	cellHeight = height / rows;
+	// the biggest field that fits in a cell without stretching
+	fieldWidth = cellWidth - VIEWPORT_GAP;
+	fieldHeight = fieldWidth * FIELD_HEIGHT / FIELD_WIDTH;
+	if (fieldHeight > cellHeight - VIEWPORT_GAP) {
+		fieldHeight = cellHeight - VIEWPORT_GAP;
+		fieldWidth = fieldHeight * FIELD_WIDTH / FIELD_HEIGHT;
+	}
+}
+
+bool MatchWall::hasRoomFor(int matchCount, int width, int height) {
+	int columns;
+	int cellWidth;
+	int cellHeight;
+	int fieldWidth;
+	int fieldHeight;
+	layOut(matchCount, width, height, columns, cellWidth, cellHeight, fieldWidth, fieldHeight);
+	return fieldWidth > 0 && fieldHeight > 0;
+}
+
+MatchWall::MatchWall(const EntityTextures *textures, int matchCount, int width, int height)
+		: pool(matchCount), renderWorld(textures, FIELD_WIDTH, FIELD_HEIGHT, renderState) {
+	SDL_assert(matchCount > 0 && matchCount <= WALL_MAX_MATCHES);
+	SDL_assert(hasRoomFor(matchCount, width, height));
+	this->matchCount = matchCount;
+	this->finishedCount = 0;
+	this->renderWorld.setLogging(false);
+
+	int columns;
+	int cellWidth;
+	int cellHeight;
+	int fieldWidth;
+	int fieldHeight;
+	layOut(matchCount, width, height, columns, cellWidth, cellHeight, fieldWidth, fieldHeight);
+
+	for (int i = 0; i < matchCount; ++i) {
+		this->matches[i] = this->pool.acquire();
+		this->previousStates[i] = this->matches[i]->state;
+		SDL_Rect viewport = {
+			(i % columns) * cellWidth + (cellWidth - fieldWidth) / 2,
+			(i / columns) * cellHeight + (cellHeight - fieldHeight) / 2,
+			fieldWidth,
+			fieldHeight
+		};
+		this->viewports[i] = viewport;
+	}
+
+	this->digits = new DigitAtlas(static_cast<int>(fieldHeight * SCORE_FONT_FRACTION));
+}
+
+MatchWall::~MatchWall() {
+	delete this->digits;
+}
+
+void MatchWall::update(float timeDelta) {
+	for (int i = 0; i < this->matchCount; ++i) {
+		Match *match = this->matches[i];
+		this->previousStates[i] = match->state;
+		match->world.update(match->state, timeDelta, this->ai, this->ai);
+		if (match->isFinished()) {
+			this->pool.release(match);
+			match = this->matches[i] = this->pool.acquire();
+			this->previousStates[i] = match->state; // don't interpolate from the old match
+			++this->finishedCount;
+		}
+	}
+}
+
+void MatchWall::render(Compositor &compositor, float alpha) {
+	for (int i = 0; i < this->matchCount; ++i) {
+		const SDL_Rect &viewport = this->viewports[i];
+		compositor.fillRect(viewport, VIEWPORT_BACKGROUND);
+
+		WorldState lerped = WorldState::lerpBetween(this->previousStates[i], this->matches[i]->state, alpha);
+		this->renderWorld.setRenderTransform(FieldTransform(FIELD_WIDTH, FIELD_HEIGHT, viewport));
+		this->renderWorld.render(lerped, compositor);
+
+		const WorldState &state = this->matches[i]->state;
+		this->digits->drawNumber(compositor, state.humanScore, viewport.x, viewport.y + viewport.h,
+			AlignH::Left, AlignV::Bottom);
+		this->digits->drawNumber(compositor, state.opponentScore, viewport.x + viewport.w, viewport.y + viewport.h,
+			AlignH::Right, AlignV::Bottom);
+	}
+}
+
+int MatchWall::getMatchCount() const {
+	return this->matchCount;
+}
+
+int MatchWall::getFinishedCount() const {
+	return this->finishedCount;
+}
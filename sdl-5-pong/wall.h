@@ -0,0 +1,74 @@
+#ifndef WALL_H
+#define WALL_H
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include "util.h"
+#include "world.h"
+#include "compositor.h"
+#include "match_pool.h"
+#include "hud.h"
+
+#define WALL_MAX_MATCHES 256
+
+/* Pre-rendered digits, so drawing a number is just a few sprite blits rather than a trip through SDL_ttf */
+class DigitAtlas {
+public:
+	/* @param fontSize how big to render the digits, in pixels */
+	explicit DigitAtlas(int fontSize);
+	~DigitAtlas();
+
+	/* Draws a non-negative number with its top left, top right etc. at x, y */
+	void drawNumber(Compositor &compositor, int number, int x, int y, AlignH alignH, AlignV alignV) const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(DigitAtlas);
+	Sprite *digits[10];
+	int digitWidth; // digits are monospaced in Vera, and we rely on it
+	int digitHeight;
+};
+
+/**
+* Lots of AI vs AI matches at once, laid out in a grid of viewports in one window. The matches come from a
+* MatchPool (a finished one is swapped for a fresh one), and everything is drawn by one World and one
+* DigitAtlas into one Compositor, so every viewport shares the same sprites and glyphs and each frame is a
+* single upload.
+*/
+class MatchWall {
+public:
+	/**
+	* @param textures the paddle and ball, shared by every viewport
+	* @param matchCount how many matches to show, at most WALL_MAX_MATCHES
+	* @param width the size of the render target to lay the viewports out in; see hasRoomFor
+	*/
+	MatchWall(const EntityTextures *textures, int matchCount, int width, int height);
+	~MatchWall();
+
+	/* @return false if matchCount viewports would be too small to draw anything in at width x height */
+	static bool hasRoomFor(int matchCount, int width, int height);
+
+	/* Simulates one timestep of every match */
+	void update(float timeDelta);
+	/* Draws every match, interpolated alpha of the way between their last two steps */
+	void render(Compositor &compositor, float alpha);
+
+	int getMatchCount() const;
+	/* @return how many matches have finished (and been replaced) so far */
+	int getFinishedCount() const;
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(MatchWall);
+	MatchPool pool;
+	int matchCount;
+	Match *matches[WALL_MAX_MATCHES];
+	WorldState previousStates[WALL_MAX_MATCHES]; // for interpolation
+	SDL_Rect viewports[WALL_MAX_MATCHES];
+	WorldState renderState; // scratch space for renderWorld's constructor
+	World renderWorld; // draws every match, moved from viewport to viewport
+	ChaseAiController ai;
+	DigitAtlas *digits;
+	int finishedCount;
+};
+
+#endif
@@ -7,156 +7,122 @@
 
 #include "world.h"
 #include "entities.h"
+#include "controllers.h"
 #include "util.h"
 
-//#define AI_PLAYS_FOR_HUMAN
-
-const float PLAYER_SPEED = 7 / PHYSICS_TIMESTEP;
-const float INITIAL_BALL_X_SPEED = 5 / PHYSICS_TIMESTEP;
-const int INITIAL_BALL_Y_SPEED_MIN = static_cast<int>(2 / PHYSICS_TIMESTEP);
-const int INITIAL_BALL_Y_SPEED_MAX = static_cast<int>(5 / PHYSICS_TIMESTEP);
-
 WorldState::WorldState() {
+	this->tick = 0;
 	this->human = MovingRect();
 	this->humanScore = 0;
 	this->opponent = MovingRect();
 	this->opponentScore = 0;
 	this->ball = MovingRect();
+	this->randomState = 1;
 }
 
 WorldState WorldState::lerpBetween(const WorldState &start, const WorldState &finish, float progress) {
 	WorldState lerped;
+	lerped.tick = start.tick;
 	lerped.human = MovingRect::lerpBetween(start.human, finish.human, progress);
 	lerped.opponent = MovingRect::lerpBetween(start.opponent, finish.opponent, progress);
 	lerped.ball = MovingRect::lerpBetween(start.ball, finish.ball, progress);
 	return lerped;
 }
 
-World::World(SDL_Renderer *renderer, int width, int height, WorldState &worldState) {
-	SDL_assert(renderer != nullptr);
+// neither has any state of its own (the keyboard controller only keeps a pointer to SDL's keyboard
+// state, fetched once the game is running), so every world can share them
+static PolicyController<KeyboardController> defaultHumanController;
+static PolicyController<ChaseAiController> defaultOpponentController;
+
+World::World(const EntityTextures *textures, int width, int height, WorldState &worldState)
+		: human(textures), opponent(textures), ball(textures) {
+	this->textures = textures;
 	this->width = width;
 	this->height = height;
+	this->listener = nullptr;
+	this->humanController = &defaultHumanController;
+	this->opponentController = &defaultOpponentController;
+	this->logging = true;
+	worldState.randomState = createRandomState();
+	initSizes(worldState);
+}
 
-	this->human = new Player(renderer, worldState.human);
-	this->opponent = new Player(renderer, worldState.opponent);
-	this->ball = new Ball(renderer, worldState.ball);
+void World::initSizes(WorldState &state) {
+	if (this->textures == nullptr) {
+		state.human.size = Vector2(PADDLE_WIDTH, PADDLE_HEIGHT);
+		state.opponent.size = Vector2(PADDLE_WIDTH, PADDLE_HEIGHT);
+		state.ball.size = Vector2(BALL_SIZE, BALL_SIZE);
+		return;
+	}
+	const float paddleWidth = static_cast<float>(this->textures->paddleWidth);
+	const float paddleHeight = static_cast<float>(this->textures->paddleHeight);
+	state.human.size = Vector2(paddleWidth, paddleHeight);
+	state.opponent.size = Vector2(paddleWidth, paddleHeight);
+	state.ball.size = Vector2(static_cast<float>(this->textures->ballWidth), static_cast<float>(this->textures->ballHeight));
 }
 
-World::~World() {
-	delete this->human;
-	delete this->opponent;
-	delete this->ball;
+void World::reset(WorldState &state) {
+	const Uint32 randomState = state.randomState; // so the next game doesn't replay this one's serves
+	state = WorldState();
+	state.randomState = randomState;
+	initSizes(state);
+	startRound(state);
 }
 
-void World::startRound(WorldState &state) {
-	state.human.pos.x = 0;
-	state.human.pos.y = height / 2 - state.human.size.y / 2;
-
-	state.opponent.pos.x = width - state.opponent.size.x;
-	state.opponent.pos.y = height / 2 - state.opponent.size.y / 2;
-
-	std::cout << "size = " << width << "," << height << std::endl;
-	std::cout << "Opponent size = " << state.opponent.size.x << "," << state.opponent.size.y << std::endl;
-	std::cout << "Opponent pos = " << state.opponent.pos.x << "," << state.opponent.pos.y << std::endl;
-
-	state.ball.pos.x = width / 2 - state.ball.size.x / 2;
-	state.ball.pos.y = height / 2 - state.ball.size.y / 2;
-	state.ball.speed.x = INITIAL_BALL_X_SPEED;
-	state.ball.speed.y = static_cast<float>(
-			randomIntInRange(INITIAL_BALL_Y_SPEED_MIN, INITIAL_BALL_Y_SPEED_MAX) * randomSignForInt()
-		);
+void World::setListener(WorldListener *listener) {
+	this->listener = listener;
 }
 
-void World::update(WorldState &state, float timeDelta) {
-#ifdef AI_PLAYS_FOR_HUMAN
-	float aiIdealDistanceToCoverHuman = state.ball.getCenter().y - state.human.getCenter().y;
-	if (aiIdealDistanceToCoverHuman > PLAYER_SPEED * timeDelta) {
-		state.human.speed.y = PLAYER_SPEED;
-	} else if (aiIdealDistanceToCoverHuman < -PLAYER_SPEED * timeDelta) {
-		state.human.speed.y = -PLAYER_SPEED;
-	} else {
-		state.human.speed.y = 0;
-	}
-#else
-	//handle non-event-based input
-	const Uint8 *keysDown = SDL_GetKeyboardState(nullptr);
-	if (keysDown[SDL_SCANCODE_UP]) {
-		state.human.speed.y = -PLAYER_SPEED;
-	} else if (keysDown[SDL_SCANCODE_DOWN]) {
-		state.human.speed.y = PLAYER_SPEED;
-	} else {
-		state.human.speed.y = 0;
-	}
-#endif
-
-	//"ai" for opponent player
-	float aiIdealDistanceToCover = state.ball.getCenter().y - state.opponent.getCenter().y;
-	if (aiIdealDistanceToCover > PLAYER_SPEED * timeDelta) {
-		state.opponent.speed.y = PLAYER_SPEED;
-	} else if (aiIdealDistanceToCover < -PLAYER_SPEED * timeDelta) {
-		state.opponent.speed.y = -PLAYER_SPEED;
-	} else {
-		state.opponent.speed.y = 0;
-	}
+void World::setControllers(Controller *human, Controller *opponent) {
+	this->humanController = human != nullptr ? human : &defaultHumanController;
+	this->opponentController = opponent != nullptr ? opponent : &defaultOpponentController;
+}
 
-	//simulate
-	state.human.pos.y += state.human.speed.y * timeDelta;
-	state.opponent.pos.y += state.opponent.speed.y * timeDelta;
-	state.ball.pos.x += state.ball.speed.x * timeDelta;
-	state.ball.pos.y += state.ball.speed.y * timeDelta;
-
-	//fixup
-
-	//FIXME ball can go so fast it will move past the paddles
-	if (rects_overlap(state.human.pos.x, state.human.pos.y, state.human.size.x, state.human.size.y,
-			state.ball.pos.x, state.ball.pos.y,
-			state.ball.size.x * 2, state.ball.size.y)) {
-		state.ball.speed.x = abs(state.ball.speed.x) * 1.1f;
-		state.ball.pos.x = state.human.pos.x + state.human.size.x;
-		std::cout << "Paddle collision (HUMAN) - ball speed is now " << state.ball.speed.x << std::endl;
-	}
-	if (rects_overlap(state.opponent.pos.x, state.opponent.pos.y, state.opponent.size.x, state.opponent.size.y,
-			state.ball.pos.x - state.ball.size.x, state.ball.pos.y,
-			state.ball.size.x * 2, state.ball.size.y)) {
-		state.ball.speed.x = -abs(state.ball.speed.x) * 1.1f;
-		state.ball.pos.x = state.opponent.pos.x - state.ball.size.x;
-		std::cout << "Paddle collision (OPPON) - ball speed is now " << state.ball.speed.x << std::endl;
-	}
+void World::setLogging(bool logging) {
+	this->logging = logging;
+}
 
-	if (state.ball.pos.y < 0) {
-		state.ball.speed.y *= -1;
-		state.ball.pos.y = 0;
-	} else if (state.ball.pos.y + state.ball.size.y > this->height) {
-		state.ball.speed.y *= -1;
-		state.ball.pos.y = this->height - state.ball.size.y;
-	}
+void World::setRenderTransform(const FieldTransform &transform) {
+	this->transform = transform;
+}
 
-	if (state.human.pos.y < 0) {
-		state.human.pos.y = 0;
-	} else if (state.human.pos.y + state.human.size.y > this->height) {
-		state.human.pos.y = this->height - state.human.size.y;
-	}
-	if (state.opponent.pos.y < 0) {
-		state.opponent.pos.y = 0;
-	} else if (state.opponent.pos.y + state.opponent.size.y > this->height) {
-		state.opponent.pos.y = this->height - state.opponent.size.y;
+void World::startRound(WorldState &state) {
+	if (this->logging) {
+		serve<true>(state);
+	} else {
+		serve<false>(state);
 	}
+}
 
-	if (state.ball.pos.x + state.ball.size.x < 0) {
-		++state.opponentScore;
-		std::cout << "AI player wins round! Score: " << state.humanScore 
-			<< " | " << state.opponentScore << std::endl;
-		startRound(state);
-	} else if (state.ball.pos.x > width) {
-		++state.humanScore;
-		std::cout << "Human player wins round! Score: " << state.humanScore 
-			<< " | " << state.opponentScore << std::endl;
-		startRound(state);
+void World::update(WorldState &state, float timeDelta) {
+	++state.tick;
+	state.human.speed.y = this->humanController->paddleSpeed(state.human, state.ball, state.tick, timeDelta);
+	state.opponent.speed.y = this->opponentController->paddleSpeed(state.opponent, state.ball, state.tick, timeDelta);
+
+	NullWorldListener nobody;
+	if (this->listener != nullptr) {
+		if (this->logging) {
+			simulate<true>(state, timeDelta, *this->listener);
+		} else {
+			simulate<false>(state, timeDelta, *this->listener);
+		}
+	} else if (this->logging) {
+		simulate<true>(state, timeDelta, nobody);
+	} else {
+		simulate<false>(state, timeDelta, nobody);
 	}
 }
 
 void World::render(WorldState &state) {
-	this->human->render(state.human);
-	this->opponent->render(state.opponent);
-	this->ball->render(state.ball);
+	SDL_assert(this->textures != nullptr); // headless worlds can't be rendered
+	this->human.render(state.human, this->transform);
+	this->opponent.render(state.opponent, this->transform);
+	this->ball.render(state.ball, this->transform);
+}
+
+void World::render(WorldState &state, Compositor &compositor) {
+	SDL_assert(this->textures != nullptr);
+	this->human.render(state.human, this->transform, compositor);
+	this->opponent.render(state.opponent, this->transform, compositor);
+	this->ball.render(state.ball, this->transform, compositor);
 }
\ No newline at end of file
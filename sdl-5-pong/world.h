@@ -1,6 +1,9 @@
 #ifndef WORLD_H
 #define WORLD_H
 
+#include <iostream>
+#include <cmath>
+
 #include <SDL.h>
 
 #include "entities.h"
@@ -8,13 +11,57 @@
 
 #define PHYSICS_TIMESTEP 0.01f
 
+// size of the playing field
+#define FIELD_WIDTH 640
+#define FIELD_HEIGHT 480
+
+// sizes of paddle.png and ball.png, for headless worlds which don't load them
+#define PADDLE_WIDTH 20
+#define PADDLE_HEIGHT 60
+#define BALL_SIZE 20
+
+const float PLAYER_SPEED = 7 / PHYSICS_TIMESTEP;
+const float INITIAL_BALL_X_SPEED = 5 / PHYSICS_TIMESTEP;
+const int INITIAL_BALL_Y_SPEED_MIN = static_cast<int>(2 / PHYSICS_TIMESTEP);
+const int INITIAL_BALL_Y_SPEED_MAX = static_cast<int>(5 / PHYSICS_TIMESTEP);
+
+class Controller;
+
+enum class WorldEvent {
+	PaddleHit,
+	WallBounce,
+	Score
+};
+
+/**
+* Receives notable things that happen during World::update(). Called synchronously from inside update(),
+* so implementations should hand the event off somewhere rather than doing real work.
+*/
+class WorldListener {
+public:
+	virtual ~WorldListener() {}
+	/**
+	* @param event what happened
+	* @param tick the simulation tick (WorldState::tick) during which it happened
+	*/
+	virtual void onWorldEvent(WorldEvent event, Uint32 tick) = 0;
+};
+
+/* Stands in for a WorldListener when nobody is listening, so notifying one compiles away to nothing */
+class NullWorldListener {
+public:
+	void onWorldEvent(WorldEvent, Uint32) {}
+};
+
 class WorldState {
 public:
+	Uint32 tick; // number of physics timesteps simulated so far
 	MovingRect human;
 	int humanScore;
 	MovingRect opponent;
 	int opponentScore;
 	MovingRect ball;
+	Uint32 randomState; // for serving; per state rather than global, so matches on different threads don't share it
 
 	WorldState();
 
@@ -23,21 +70,173 @@ public:
 
 class World {
 public:
-	Player *human;
-	Player *opponent;
-	Ball *ball;
+	Player human;
+	Player opponent;
+	Ball ball;
 
-	World(SDL_Renderer *renderer, int width, int height, WorldState &worldState);
-	~World();
+	/**
+	* Doesn't allocate anything, so worlds are cheap to keep around and reuse (see reset).
+	* @param textures what to draw with (not owned, so they must outlive the world), or nullptr for a
+	* headless world which can't be rendered (and so doesn't need a window)
+	* @param worldState also gets its random number generator seeded, from rand(); so call this from the main thread
+	*/
+	World(const EntityTextures *textures, int width, int height, WorldState &worldState);
+
+	void setListener(WorldListener *listener);
+	/**
+	* Chooses who moves each paddle in update(WorldState &, float). The controllers aren't owned by the
+	* world, so must outlive it. By default the human uses the keyboard and the opponent chases the ball.
+	* @param human the human paddle's controller, or nullptr for the default
+	* @param opponent the opponent paddle's controller, or nullptr for the default
+	*/
+	void setControllers(Controller *human, Controller *opponent);
+	/* whether to print collisions and scores to stdout; on by default */
+	void setLogging(bool logging);
+	/* where on the render target to draw the field; by default one field unit is one pixel */
+	void setRenderTransform(const FieldTransform &transform);
 
 	void startRound(WorldState &state);
+	/* Starts a whole new game in state, reusing this world */
+	void reset(WorldState &state);
+	/* Simulates one timestep, with the controllers chosen by setControllers */
 	void update(WorldState &state, float timeDelta);
+	/**
+	* Simulates one timestep with controller policies (see controllers.h) known at compile time, so
+	* there's no virtual call or branching on who's in control; use this in hot loops. It never logs or
+	* notifies the listener, so it doesn't check whether to either.
+	*/
+	template<typename HumanController, typename OpponentController>
+	void update(WorldState &state, float timeDelta, HumanController &human, OpponentController &opponent);
 	void render(WorldState &state);
+	void render(WorldState &state, Compositor &compositor);
 
 private:
 	DISALLOW_COPY_AND_ASSIGN(World);
+	const EntityTextures *textures;
 	int width;
 	int height;
+	WorldListener *listener;
+	Controller *humanController;
+	Controller *opponentController;
+	bool logging;
+	FieldTransform transform;
+
+	// sets the entities' sizes from their textures or, for headless worlds, the sizes they'd have
+	void initSizes(WorldState &state);
+	// startRound, with whether to log decided at compile time
+	template<bool Logging>
+	void serve(WorldState &state);
+	/**
+	* Moves everything at the speeds it's been given, then handles collisions and scoring. Logging and
+	* the listener's type are template parameters so the hot path has no runtime checks for either.
+	* Defined here rather than in world.cpp so update() with controller policies inlines all of it.
+	*/
+	template<bool Logging, typename Listener>
+	void simulate(WorldState &state, float timeDelta, Listener &listener);
 };
 
+template<typename HumanController, typename OpponentController>
+inline void World::update(WorldState &state, float timeDelta, HumanController &human, OpponentController &opponent) {
+	++state.tick;
+	state.human.speed.y = human.paddleSpeed(state.human, state.ball, state.tick, timeDelta);
+	state.opponent.speed.y = opponent.paddleSpeed(state.opponent, state.ball, state.tick, timeDelta);
+	NullWorldListener nobody;
+	simulate<false>(state, timeDelta, nobody);
+}
+
+template<bool Logging>
+inline void World::serve(WorldState &state) {
+	state.human.pos.x = 0;
+	state.human.pos.y = height / 2 - state.human.size.y / 2;
+
+	state.opponent.pos.x = width - state.opponent.size.x;
+	state.opponent.pos.y = height / 2 - state.opponent.size.y / 2;
+
+	if (Logging) {
+		std::cout << "size = " << width << "," << height << std::endl;
+		std::cout << "Opponent size = " << state.opponent.size.x << "," << state.opponent.size.y << std::endl;
+		std::cout << "Opponent pos = " << state.opponent.pos.x << "," << state.opponent.pos.y << std::endl;
+	}
+
+	state.ball.pos.x = width / 2 - state.ball.size.x / 2;
+	state.ball.pos.y = height / 2 - state.ball.size.y / 2;
+	state.ball.speed.x = INITIAL_BALL_X_SPEED;
+	state.ball.speed.y = static_cast<float>(
+			randomIntInRange(state.randomState, INITIAL_BALL_Y_SPEED_MIN, INITIAL_BALL_Y_SPEED_MAX)
+			* randomSignForInt(state.randomState)
+		);
+}
+
+template<bool Logging, typename Listener>
+inline void World::simulate(WorldState &state, float timeDelta, Listener &listener) {
+	//simulate
+	state.human.pos.y += state.human.speed.y * timeDelta;
+	state.opponent.pos.y += state.opponent.speed.y * timeDelta;
+	state.ball.pos.x += state.ball.speed.x * timeDelta;
+	state.ball.pos.y += state.ball.speed.y * timeDelta;
+
+	//fixup
+
+	//FIXME ball can go so fast it will move past the paddles
+	if (rects_overlap(state.human.pos.x, state.human.pos.y, state.human.size.x, state.human.size.y,
+			state.ball.pos.x, state.ball.pos.y,
+			state.ball.size.x * 2, state.ball.size.y)) {
+		state.ball.speed.x = std::abs(state.ball.speed.x) * 1.1f;
+		state.ball.pos.x = state.human.pos.x + state.human.size.x;
+		listener.onWorldEvent(WorldEvent::PaddleHit, state.tick);
+		if (Logging) {
+			std::cout << "Paddle collision (HUMAN) - ball speed is now " << state.ball.speed.x << std::endl;
+		}
+	}
+	if (rects_overlap(state.opponent.pos.x, state.opponent.pos.y, state.opponent.size.x, state.opponent.size.y,
+			state.ball.pos.x - state.ball.size.x, state.ball.pos.y,
+			state.ball.size.x * 2, state.ball.size.y)) {
+		state.ball.speed.x = -std::abs(state.ball.speed.x) * 1.1f;
+		state.ball.pos.x = state.opponent.pos.x - state.ball.size.x;
+		listener.onWorldEvent(WorldEvent::PaddleHit, state.tick);
+		if (Logging) {
+			std::cout << "Paddle collision (OPPON) - ball speed is now " << state.ball.speed.x << std::endl;
+		}
+	}
+
+	if (state.ball.pos.y < 0) {
+		state.ball.speed.y *= -1;
+		state.ball.pos.y = 0;
+		listener.onWorldEvent(WorldEvent::WallBounce, state.tick);
+	} else if (state.ball.pos.y + state.ball.size.y > this->height) {
+		state.ball.speed.y *= -1;
+		state.ball.pos.y = this->height - state.ball.size.y;
+		listener.onWorldEvent(WorldEvent::WallBounce, state.tick);
+	}
+
+	if (state.human.pos.y < 0) {
+		state.human.pos.y = 0;
+	} else if (state.human.pos.y + state.human.size.y > this->height) {
+		state.human.pos.y = this->height - state.human.size.y;
+	}
+	if (state.opponent.pos.y < 0) {
+		state.opponent.pos.y = 0;
+	} else if (state.opponent.pos.y + state.opponent.size.y > this->height) {
+		state.opponent.pos.y = this->height - state.opponent.size.y;
+	}
+
+	if (state.ball.pos.x + state.ball.size.x < 0) {
+		++state.opponentScore;
+		listener.onWorldEvent(WorldEvent::Score, state.tick);
+		if (Logging) {
+			std::cout << "AI player wins round! Score: " << state.humanScore
+				<< " | " << state.opponentScore << std::endl;
+		}
+		serve<Logging>(state);
+	} else if (state.ball.pos.x > width) {
+		++state.humanScore;
+		listener.onWorldEvent(WorldEvent::Score, state.tick);
+		if (Logging) {
+			std::cout << "Human player wins round! Score: " << state.humanScore
+				<< " | " << state.opponentScore << std::endl;
+		}
+		serve<Logging>(state);
+	}
+}
+
 #endif